@@ -1,68 +1,253 @@
 #include "AESWrapper.h"
-
-#include <modes.h>
-#include <aes.h>
-#include <filters.h>
+#include "CryptoContext.h"
+#include "WorkerPool.h"
 
 #include <stdexcept>
-#include <immintrin.h>	// _rdrand32_step
+#include <cstring>
+#include <atomic>
+
+
+static const CryptoPP::byte ZERO_IV[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+
+// Sealed messages of at least this many segments are spread over the worker pool, with at least
+// SEGMENTS_PER_WORKER segments per worker; shorter ones are not worth the hand-off.
+static const size_t PARALLEL_MIN_SEGMENTS = 8;
+static const size_t SEGMENTS_PER_WORKER = 2;
+
+static const size_t GCM_IV_SIZE = 12;
+static const uint32_t LAST_SEGMENT_FLAG = 0x80000000;
+
+// IV of one segment: [8 bytes message nonce][4 bytes big-endian segment index, top bit set on the last segment].
+static void segmentIv(CryptoPP::byte* iv, const CryptoPP::byte* nonce, size_t index, bool last)
+{
+	uint32_t counter = static_cast<uint32_t>(index) | (last ? LAST_SEGMENT_FLAG : 0);
+	std::memcpy(iv, nonce, AESWrapper::NONCE_SIZE);
+	for (int i = 0; i < 4; i++)
+		iv[AESWrapper::NONCE_SIZE + i] = static_cast<CryptoPP::byte>(counter >> (24 - 8 * i));
+}
+
+static size_t segmentCount(size_t plainLength)
+{
+	return std::max<size_t>(1, (plainLength + AESWrapper::SEGMENT_SIZE - 1) / AESWrapper::SEGMENT_SIZE);
+}
+
+// Works out the segments of a sealed message from its length: every segment but the last is full,
+// and only an empty message has an empty segment. Returns false if no seal produces this length.
+static bool sealedLayout(size_t length, size_t& segments, size_t& plainLength)
+{
+	const size_t fullSegment = AESWrapper::SEGMENT_SIZE + AESWrapper::TAG_SIZE;
+	if (length < AESWrapper::NONCE_SIZE + AESWrapper::TAG_SIZE)
+		return false;
+	size_t body = length - AESWrapper::NONCE_SIZE;
+	size_t rest = body % fullSegment;
+	if (rest != 0 && (rest < AESWrapper::TAG_SIZE || (rest == AESWrapper::TAG_SIZE && body > rest)))
+		return false;
+	segments = body / fullSegment + (rest != 0 ? 1 : 0);
+	if (segments - 1 > ~LAST_SEGMENT_FLAG)
+		return false;
+	plainLength = body - segments * AESWrapper::TAG_SIZE;
+	return true;
+}
+
+// Runs body(first, last, useMemberContext) over ranges of segments: in one go for short messages,
+// spread over the worker pool for long ones. Only the range that starts at 0 may use the
+// wrapper's own mode objects; the others key a context of their own.
+template<class Body>
+static void forSegmentRanges(size_t segments, const Body& body)
+{
+	WorkerPool& pool = WorkerPool::shared();
+	size_t workers = std::min(pool.size() + 1, segments / SEGMENTS_PER_WORKER);
+	if (segments < PARALLEL_MIN_SEGMENTS || workers < 2)
+	{
+		body(0, segments, true);
+		return;
+	}
+	pool.parallelFor(workers, [&](size_t worker) {
+		body(segments * worker / workers, segments * (worker + 1) / workers, worker == 0);
+	});
+}
 
 
 unsigned char* AESWrapper::GenerateKey(unsigned char* buffer, unsigned int length)
 {
-	for (size_t i = 0; i < length; i += sizeof(unsigned int))
-		_rdrand32_step(reinterpret_cast<unsigned int*>(&buffer[i]));
+	CryptoContext::instance().generateBlock(buffer, length);
 	return buffer;
 }
 
 AESWrapper::AESWrapper()
 {
-	GenerateKey(_key, DEFAULT_KEYLENGTH);
+	static_assert(DEFAULT_KEYLENGTH == CryptoContext::SESSION_KEY_SIZE, "session keys are AES keys");
+	CryptoContext::instance().takeSessionKey(_key);
+	initializeCiphers();
 }
 
 AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
 {
 	if (length != DEFAULT_KEYLENGTH)
 		throw std::length_error("key length must be 16 bytes");
-	memcpy_s(_key, DEFAULT_KEYLENGTH, key, length);
+	std::memcpy(_key, key, DEFAULT_KEYLENGTH);
+	initializeCiphers();
 }
 
 AESWrapper::~AESWrapper()
 {
 }
 
+// Expands the key schedules once; each message only resets the IV.
+void AESWrapper::initializeCiphers()
+{
+	_encryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, ZERO_IV, BLOCKSIZE);
+	_decryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, ZERO_IV, BLOCKSIZE);
+	_gcmEncryption.SetKey(_key, DEFAULT_KEYLENGTH);
+	_gcmDecryption.SetKey(_key, DEFAULT_KEYLENGTH);
+}
+
 const unsigned char* AESWrapper::getKey() const 
 { 
 	return _key; 
 }
 
-std::string AESWrapper::encrypt(const char* plain, unsigned int length)
+size_t AESWrapper::encrypt(const char* plain, size_t length, char* out, size_t outSize)
 {
-	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
-
-	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption(aesEncryption, iv);
+	size_t cipherLength = encryptedSize(length);
+	if (outSize < cipherLength)
+		throw std::length_error("output buffer too small for the cipher text");
+
+	// Full blocks go straight through; the last block carries the rest of the plain text and the padding.
+	size_t fullLength = length - length % BLOCKSIZE;
+	CryptoPP::byte lastBlock[BLOCKSIZE];
+	std::memcpy(lastBlock, plain + fullLength, length - fullLength);
+	std::memset(lastBlock + (length - fullLength), static_cast<int>(cipherLength - length), cipherLength - length);
+
+	_encryption.Resynchronize(ZERO_IV, BLOCKSIZE);
+	CryptoPP::byte* output = reinterpret_cast<CryptoPP::byte*>(out);
+	_encryption.ProcessData(output, reinterpret_cast<const CryptoPP::byte*>(plain), fullLength);
+	_encryption.ProcessData(output + fullLength, lastBlock, BLOCKSIZE);
+	return cipherLength;
+}
 
-	std::string cipher;
-	CryptoPP::StreamTransformationFilter stfEncryptor(cbcEncryption, new CryptoPP::StringSink(cipher));
-	stfEncryptor.Put(reinterpret_cast<const CryptoPP::byte*>(plain), length);
-	stfEncryptor.MessageEnd();
+size_t AESWrapper::decrypt(const char* cipher, size_t length, char* out, size_t outSize)
+{
+	if (length == 0 || length % BLOCKSIZE != 0)
+		throw CryptoPP::InvalidCiphertext("AES/CBC: cipher text length is not a multiple of the block size");
+	if (outSize < maxDecryptedSize(length))
+		throw std::length_error("output buffer too small for the plain text");
+
+	CryptoPP::byte* output = reinterpret_cast<CryptoPP::byte*>(out);
+	_decryption.Resynchronize(ZERO_IV, BLOCKSIZE);
+	_decryption.ProcessData(output, reinterpret_cast<const CryptoPP::byte*>(cipher), length);
+
+	unsigned int padding = output[length - 1];
+	if (padding == 0 || padding > BLOCKSIZE)
+		throw CryptoPP::InvalidCiphertext("AES/CBC: invalid PKCS #7 block padding found");
+	for (size_t i = length - padding; i < length; i++)
+		if (output[i] != padding)
+			throw CryptoPP::InvalidCiphertext("AES/CBC: invalid PKCS #7 block padding found");
+	return length - padding;
+}
 
+std::string AESWrapper::encrypt(const char* plain, unsigned int length)
+{
+	std::string cipher(encryptedSize(length), '\0');
+	encrypt(plain, length, &cipher[0], cipher.size());
 	return cipher;
 }
 
 
 std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 {
-	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	std::string decrypted(maxDecryptedSize(length), '\0');
+	decrypted.resize(decrypt(cipher, length, &decrypted[0], decrypted.size()));
+	return decrypted;
+}
 
-	CryptoPP::AES::Decryption aesDecryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, iv);
 
-	std::string decrypted;
-	CryptoPP::StreamTransformationFilter stfDecryptor(cbcDecryption, new CryptoPP::StringSink(decrypted));
-	stfDecryptor.Put(reinterpret_cast<const CryptoPP::byte*>(cipher), length);
-	stfDecryptor.MessageEnd();
+size_t AESWrapper::sealedSize(size_t plainLength)
+{
+	return NONCE_SIZE + plainLength + segmentCount(plainLength) * TAG_SIZE;
+}
 
-	return decrypted;
+size_t AESWrapper::seal(const char* plain, size_t length, char* out, size_t outSize)
+{
+	size_t sealedLength = sealedSize(length);
+	if (outSize < sealedLength)
+		throw std::length_error("output buffer too small for the sealed message");
+
+	CryptoPP::byte* output = reinterpret_cast<CryptoPP::byte*>(out);
+	const CryptoPP::byte* input = reinterpret_cast<const CryptoPP::byte*>(plain);
+	GenerateKey(output, NONCE_SIZE);
+	size_t segments = segmentCount(length);
+
+	forSegmentRanges(segments, [&](size_t first, size_t last, bool useMemberContext) {
+		CryptoPP::GCM<CryptoPP::AES>::Encryption context;
+		CryptoPP::GCM<CryptoPP::AES>::Encryption* gcm = &_gcmEncryption;
+		if (!useMemberContext)
+		{
+			context.SetKey(_key, DEFAULT_KEYLENGTH);
+			gcm = &context;
+		}
+		CryptoPP::byte iv[GCM_IV_SIZE];
+		for (size_t i = first; i < last; i++)
+		{
+			size_t offset = i * SEGMENT_SIZE;
+			size_t segmentLength = std::min(SEGMENT_SIZE, length - offset);
+			CryptoPP::byte* segment = output + NONCE_SIZE + i * (SEGMENT_SIZE + TAG_SIZE);
+			segmentIv(iv, output, i, i + 1 == segments);
+			gcm->EncryptAndAuthenticate(segment, segment + segmentLength, TAG_SIZE, iv, GCM_IV_SIZE,
+				nullptr, 0, input + offset, segmentLength);
+		}
+	});
+	return sealedLength;
+}
+
+size_t AESWrapper::open(const char* sealed, size_t length, char* out, size_t outSize)
+{
+	size_t segments, plainLength;
+	if (!sealedLayout(length, segments, plainLength))
+		throw CryptoPP::InvalidCiphertext("AES/GCM: sealed message length is invalid");
+	if (outSize < maxOpenedSize(length))
+		throw std::length_error("output buffer too small for the plain text");
+
+	CryptoPP::byte* output = reinterpret_cast<CryptoPP::byte*>(out);
+	const CryptoPP::byte* input = reinterpret_cast<const CryptoPP::byte*>(sealed);
+	std::atomic<bool> failed{ false };
+
+	forSegmentRanges(segments, [&](size_t first, size_t last, bool useMemberContext) {
+		CryptoPP::GCM<CryptoPP::AES>::Decryption context;
+		CryptoPP::GCM<CryptoPP::AES>::Decryption* gcm = &_gcmDecryption;
+		if (!useMemberContext)
+		{
+			context.SetKey(_key, DEFAULT_KEYLENGTH);
+			gcm = &context;
+		}
+		CryptoPP::byte iv[GCM_IV_SIZE];
+		// A segment that fails to authenticate stops every range; the rest is not decrypted.
+		for (size_t i = first; i < last && !failed; i++)
+		{
+			size_t offset = i * SEGMENT_SIZE;
+			size_t segmentLength = std::min(SEGMENT_SIZE, plainLength - offset);
+			const CryptoPP::byte* segment = input + NONCE_SIZE + i * (SEGMENT_SIZE + TAG_SIZE);
+			segmentIv(iv, input, i, i + 1 == segments);
+			if (!gcm->DecryptAndVerify(output + offset, segment + segmentLength, TAG_SIZE, iv, GCM_IV_SIZE,
+				nullptr, 0, segment, segmentLength))
+				failed = true;
+		}
+	});
+	if (failed)
+		throw CryptoPP::InvalidCiphertext("AES/GCM: message authentication failed");
+	return plainLength;
+}
+
+std::string AESWrapper::seal(const char* plain, size_t length)
+{
+	std::string sealed(sealedSize(length), '\0');
+	seal(plain, length, &sealed[0], sealed.size());
+	return sealed;
+}
+
+std::string AESWrapper::open(const char* sealed, size_t length)
+{
+	std::string opened(maxOpenedSize(length), '\0');
+	opened.resize(open(sealed, length, &opened[0], opened.size()));
+	return opened;
 }
@@ -1,18 +1,59 @@
 #pragma once
 
+#include <modes.h>
+#include <aes.h>
+#include <gcm.h>
+
 #include <string>
 
 
+/**
+ * AES-128 message encryption with one shared key, in two modes:
+ *
+ * - encrypt/decrypt: CBC with a zero IV and PKCS#7 padding (protocol version 1 contents).
+ * - seal/open: segmented AES-GCM (protocol version 2 contents). A sealed message is
+ *   [8 bytes random nonce] followed by segments of up to SEGMENT_SIZE bytes of cipher text, each
+ *   followed by its 16-byte tag. The IV of a segment is the nonce, the segment index and a flag on
+ *   the last segment, so segments cannot be reordered, dropped or cut off unnoticed. Segments are
+ *   independent, so long messages are sealed and opened on several cores (WorkerPool), and opening
+ *   stops at the first segment that fails to authenticate.
+ *
+ * The key schedules and the mode objects are set up once, when the wrapper is created, and
+ * reused for every message, so one wrapper per peer serves any number of messages. The buffer
+ * overloads write into caller-supplied memory whose required size is known in advance
+ * (encryptedSize / maxDecryptedSize, sealedSize / maxOpenedSize) and do not allocate. A wrapper
+ * keeps per-message state, so it must not be used by several threads at once.
+ */
 class AESWrapper
 {
 public:
 	static const unsigned int DEFAULT_KEYLENGTH = 16;
+	static const unsigned int BLOCKSIZE = CryptoPP::AES::BLOCKSIZE;
+	static constexpr unsigned int NONCE_SIZE = 8;
+	static constexpr unsigned int TAG_SIZE = 16;
+	static constexpr size_t SEGMENT_SIZE = 16 * 1024;
 private:
 	unsigned char _key[DEFAULT_KEYLENGTH];
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption _encryption;
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption _decryption;
+	CryptoPP::GCM<CryptoPP::AES>::Encryption _gcmEncryption;
+	CryptoPP::GCM<CryptoPP::AES>::Decryption _gcmDecryption;
+
 	AESWrapper(const AESWrapper& aes);
+	AESWrapper& operator=(const AESWrapper& aes);
+	void initializeCiphers();
 public:
 	static unsigned char* GenerateKey(unsigned char* buffer, unsigned int length);
 
+	// Size of the cipher text of a plain text of the given length (the padding adds 1 to 16 bytes).
+	static size_t encryptedSize(size_t plainLength) { return (plainLength / BLOCKSIZE + 1) * BLOCKSIZE; }
+	// Upper bound of the plain text size of a cipher text of the given length.
+	static size_t maxDecryptedSize(size_t cipherLength) { return cipherLength; }
+	// Size of the sealed form of a plain text of the given length (nonce and one tag per segment added).
+	static size_t sealedSize(size_t plainLength);
+	// Upper bound of the plain text size of a sealed message of the given length.
+	static size_t maxOpenedSize(size_t sealedLength) { return sealedLength; }
+
 	AESWrapper();
 	AESWrapper(const unsigned char* key, unsigned int size);
 	~AESWrapper();
@@ -21,4 +62,17 @@ public:
 
 	std::string encrypt(const char* plain, unsigned int length);
 	std::string decrypt(const char* cipher, unsigned int length);
+
+	// Encrypts into out, which must hold encryptedSize(length) bytes; returns that size.
+	size_t encrypt(const char* plain, size_t length, char* out, size_t outSize);
+	// Decrypts into out, which must hold maxDecryptedSize(length) bytes; returns the plain text size.
+	size_t decrypt(const char* cipher, size_t length, char* out, size_t outSize);
+
+	std::string seal(const char* plain, size_t length);
+	std::string open(const char* sealed, size_t length);
+
+	// Seals into out, which must hold sealedSize(length) bytes; returns that size.
+	size_t seal(const char* plain, size_t length, char* out, size_t outSize);
+	// Opens into out, which must hold maxOpenedSize(length) bytes; returns the plain text size.
+	size_t open(const char* sealed, size_t length, char* out, size_t outSize);
 };
\ No newline at end of file
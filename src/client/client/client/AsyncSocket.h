@@ -0,0 +1,123 @@
+﻿#pragma once
+#include "SocketWrapper.h"
+#include "Task.h"
+
+
+/**
+ * @brief Awaitable adapters over the asynchronous SocketWrapper operations.
+ *
+ * Each adapter starts the operation when the coroutine suspends and resumes the coroutine from the
+ * EventLoop when the operation completes, rethrowing its error at the co_await. The socket (and, for
+ * sends, the buffers) must stay alive until the co_await returns.
+ *
+ * Example:
+ * @code
+ *   co_await asyncConnect(loop, socket);
+ *   co_await asyncSend(loop, socket, buffers, count);
+ *   std::vector<uint8_t> frame = co_await asyncReceiveFrame(loop, socket, maxFrameSize);
+ * @endcode
+ */
+
+/**
+ * @brief Awaiter that completes the connect started by the SocketWrapper constructor.
+ */
+class ConnectAwaiter {
+public:
+    ConnectAwaiter(EventLoop& loop, SocketWrapper& socket) : _loop(loop), _socket(socket) {}
+
+    bool await_ready() const noexcept { return !_socket.isConnecting(); }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        _socket.connectAsync(_loop, [this, awaiting](std::exception_ptr error) {
+            _error = error;
+            awaiting.resume();
+        });
+    }
+
+    void await_resume() const {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+private:
+    EventLoop& _loop;
+    SocketWrapper& _socket;
+    std::exception_ptr _error;
+};
+
+/**
+ * @brief Awaiter that sends several buffers (see SocketWrapper::sendBuffersAsync).
+ */
+class SendAwaiter {
+public:
+    SendAwaiter(EventLoop& loop, SocketWrapper& socket, const ConstBuffer* buffers, size_t count)
+        : _loop(loop), _socket(socket), _buffers(buffers), _count(count) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        _socket.sendBuffersAsync(_loop, _buffers, _count, [this, awaiting](std::exception_ptr error) {
+            _error = error;
+            awaiting.resume();
+        });
+    }
+
+    void await_resume() const {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+private:
+    EventLoop& _loop;
+    SocketWrapper& _socket;
+    const ConstBuffer* _buffers;
+    size_t _count;
+    std::exception_ptr _error;
+};
+
+/**
+ * @brief Awaiter that receives one protocol frame (see SocketWrapper::receiveFrameAsync).
+ */
+class ReceiveFrameAwaiter {
+public:
+    ReceiveFrameAwaiter(EventLoop& loop, SocketWrapper& socket, size_t maxFrameSize)
+        : _loop(loop), _socket(socket), _maxFrameSize(maxFrameSize) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        _socket.receiveFrameAsync(_loop, _maxFrameSize, [this, awaiting](std::vector<uint8_t> frame, std::exception_ptr error) {
+            _frame = std::move(frame);
+            _error = error;
+            awaiting.resume();
+        });
+    }
+
+    std::vector<uint8_t> await_resume() {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        return std::move(_frame);
+    }
+
+private:
+    EventLoop& _loop;
+    SocketWrapper& _socket;
+    size_t _maxFrameSize;
+    std::vector<uint8_t> _frame;
+    std::exception_ptr _error;
+};
+
+inline ConnectAwaiter asyncConnect(EventLoop& loop, SocketWrapper& socket) {
+    return ConnectAwaiter(loop, socket);
+}
+
+inline SendAwaiter asyncSend(EventLoop& loop, SocketWrapper& socket, const ConstBuffer* buffers, size_t count) {
+    return SendAwaiter(loop, socket, buffers, count);
+}
+
+inline ReceiveFrameAwaiter asyncReceiveFrame(EventLoop& loop, SocketWrapper& socket, size_t maxFrameSize) {
+    return ReceiveFrameAwaiter(loop, socket, maxFrameSize);
+}
\ No newline at end of file
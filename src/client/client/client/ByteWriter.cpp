@@ -0,0 +1,72 @@
+﻿#include "ByteWriter.h"
+
+
+ByteWriter::ByteWriter(size_t capacity) {
+    _bytes.reserve(capacity);
+}
+
+ByteWriter& ByteWriter::putUint8(uint8_t value) {
+    _bytes.push_back(value);
+    return *this;
+}
+
+ByteWriter& ByteWriter::putUint16(uint16_t value) {
+    writeUint16(putSpace(2), value);
+    return *this;
+}
+
+ByteWriter& ByteWriter::putUint32(uint32_t value) {
+    writeUint32(putSpace(4), value);
+    return *this;
+}
+
+ByteWriter& ByteWriter::putBytes(const void* data, size_t length) {
+    if (length > 0) {
+        std::memcpy(putSpace(length), data, length);
+    }
+    return *this;
+}
+
+ByteWriter& ByteWriter::putPadded(std::string_view bytes, size_t width) {
+    uint8_t* field = putSpace(width);
+    size_t copied = std::min(bytes.size(), width);
+    std::memcpy(field, bytes.data(), copied);
+    std::memset(field + copied, 0, width - copied);
+    return *this;
+}
+
+uint8_t* ByteWriter::putSpace(size_t length) {
+    size_t offset = _bytes.size();
+    _bytes.resize(offset + length);
+    return _bytes.data() + offset;
+}
+
+ByteWriterPool::Lease::~Lease() {
+    if (_writer) {
+        _pool->release(std::move(_writer));
+    }
+}
+
+ByteWriterPool::Lease ByteWriterPool::acquire(size_t capacity) {
+    std::unique_ptr<ByteWriter> writer;
+    if (_free.empty()) {
+        writer = std::make_unique<ByteWriter>(capacity);
+    }
+    else {
+        writer = std::move(_free.back());
+        _free.pop_back();
+        writer->reserve(capacity);
+    }
+    return Lease(*this, std::move(writer));
+}
+
+void ByteWriterPool::release(std::unique_ptr<ByteWriter> writer) {
+    if (_free.size() >= MAX_FREE_WRITERS || writer->capacity() > MAX_RETAINED_CAPACITY) {
+        return;
+    }
+    writer->reset();
+    if (_free.capacity() == 0) {
+        _free.reserve(MAX_FREE_WRITERS);
+    }
+    _free.push_back(std::move(writer));
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+﻿#pragma once
+#include "utils.h"
+
+
+/**
+ * @brief Builds a binary payload: little-endian fields and byte runs appended to one buffer.
+ *
+ * The buffer keeps its capacity across reset, so a writer that is reused for payloads of similar
+ * size stops allocating once it has grown to the largest one. Writers are normally taken from a
+ * ByteWriterPool for the duration of one request.
+ */
+class ByteWriter {
+public:
+    explicit ByteWriter(size_t capacity = 0);
+
+    /**
+     * @brief Empties the writer, keeping its capacity.
+     */
+    void reset() { _bytes.clear(); }
+
+    /**
+     * @brief Makes room for \p size bytes in total, so appending up to that size does not allocate.
+     */
+    void reserve(size_t size) { _bytes.reserve(size); }
+
+    ByteWriter& putUint8(uint8_t value);
+    ByteWriter& putUint16(uint16_t value);
+    ByteWriter& putUint32(uint32_t value);
+    ByteWriter& putBytes(const void* data, size_t length);
+    ByteWriter& putBytes(std::string_view bytes) { return putBytes(bytes.data(), bytes.size()); }
+
+    /**
+     * @brief Appends \p bytes as a fixed-size field of \p width bytes, null-padded or truncated.
+     */
+    ByteWriter& putPadded(std::string_view bytes, size_t width);
+
+    /**
+     * @brief Appends \p length bytes to be filled in place (e.g. by an encryption) and returns them.
+     *
+     * The pointer is valid until the next append.
+     */
+    uint8_t* putSpace(size_t length);
+
+    const uint8_t* data() const { return _bytes.data(); }
+    size_t size() const { return _bytes.size(); }
+    size_t capacity() const { return _bytes.capacity(); }
+
+    /**
+     * @brief Moves the built payload out; the writer is left empty, without capacity.
+     */
+    std::vector<uint8_t> take() { return std::move(_bytes); }
+
+private:
+    std::vector<uint8_t> _bytes;
+};
+
+/**
+ * @brief Free list of ByteWriters, so the payload buffers are reused from one request to the next.
+ *
+ * Each request in flight holds its own writer (a Lease); when the lease ends, the writer is reset
+ * and goes back to the pool with its capacity. Writers that grew beyond MAX_RETAINED_CAPACITY (e.g.
+ * for a large batch) are freed instead, and at most MAX_FREE_WRITERS are kept. The pool is not
+ * thread-safe; it is used from the thread that runs the client's event loop.
+ */
+class ByteWriterPool {
+public:
+    static const size_t MAX_FREE_WRITERS = 16;
+    static const size_t MAX_RETAINED_CAPACITY = 1024 * 1024;
+
+    /**
+     * @brief A writer borrowed from the pool; it is given back when the lease is destroyed.
+     */
+    class Lease {
+    public:
+        Lease(ByteWriterPool& pool, std::unique_ptr<ByteWriter> writer) : _pool(&pool), _writer(std::move(writer)) {}
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) = delete;
+        ~Lease();
+
+        ByteWriter& operator*() const { return *_writer; }
+        ByteWriter* operator->() const { return _writer.get(); }
+
+    private:
+        ByteWriterPool* _pool;
+        std::unique_ptr<ByteWriter> _writer;
+    };
+
+    ByteWriterPool() = default;
+    ByteWriterPool(const ByteWriterPool&) = delete;
+    ByteWriterPool& operator=(const ByteWriterPool&) = delete;
+
+    /**
+     * @brief Takes an empty writer from the pool (or a new one), with at least \p capacity bytes reserved.
+     */
+    Lease acquire(size_t capacity = 0);
+
+    size_t freeWriters() const { return _free.size(); }
+
+private:
+    void release(std::unique_ptr<ByteWriter> writer);
+
+    std::vector<std::unique_ptr<ByteWriter>> _free; ///< Idle writers, most recently released last.
+};
\ No newline at end of file
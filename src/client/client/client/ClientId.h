@@ -0,0 +1,93 @@
+﻿#pragma once
+#include "utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLIENT_ID_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * @brief A raw 16-byte client ID, held by value.
+ *
+ * Copying, hashing and comparing an ID never allocates: the bytes live in the object, equality is
+ * one 16-byte SSE2 compare (two 64-bit compares without SSE2), and the hash mixes the two 64-bit
+ * halves, which is enough since the server assigns random UUIDs. A default-constructed ID is all
+ * zeros, the ID of a client that has not registered yet.
+ */
+class ClientId {
+public:
+    static const size_t SIZE = 16;
+
+    ClientId() : _bytes{} {}
+
+    /**
+     * @brief Copies an ID from \p SIZE bytes at \p bytes.
+     */
+    explicit ClientId(const void* bytes) { std::memcpy(_bytes.data(), bytes, SIZE); }
+
+    /**
+     * @brief Copies an ID from a string of exactly SIZE bytes.
+     *
+     * @throws std::invalid_argument if \p bytes is not SIZE bytes long.
+     */
+    static ClientId fromBytes(std::string_view bytes) {
+        if (bytes.size() != SIZE) {
+            throw std::invalid_argument("A client ID must be 16 bytes long");
+        }
+        return ClientId(bytes.data());
+    }
+
+    const uint8_t* data() const { return _bytes.data(); }
+    static constexpr size_t size() { return SIZE; }
+
+    /**
+     * @brief The raw bytes, viewed in place (e.g. to write them into a request).
+     */
+    std::string_view view() const { return std::string_view(reinterpret_cast<const char*>(_bytes.data()), SIZE); }
+
+    /**
+     * @brief Whether this is the all-zero ID of an unregistered client.
+     */
+    bool isNull() const { return *this == ClientId(); }
+
+    uint64_t hash() const {
+        uint64_t low, high;
+        std::memcpy(&low, _bytes.data(), sizeof(low));
+        std::memcpy(&high, _bytes.data() + sizeof(low), sizeof(high));
+        uint64_t hash = (low ^ (high * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+        return hash ^ (hash >> 31);
+    }
+
+    friend bool operator==(const ClientId& a, const ClientId& b) {
+#ifdef CLIENT_ID_SSE2
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a._bytes.data())),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b._bytes.data())));
+        return _mm_movemask_epi8(equal) == 0xFFFF;
+#else
+        uint64_t a0, a1, b0, b1;
+        std::memcpy(&a0, a._bytes.data(), 8);
+        std::memcpy(&a1, a._bytes.data() + 8, 8);
+        std::memcpy(&b0, b._bytes.data(), 8);
+        std::memcpy(&b1, b._bytes.data() + 8, 8);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+#endif
+    }
+
+    friend bool operator!=(const ClientId& a, const ClientId& b) { return !(a == b); }
+
+    /**
+     * @brief Byte order, the order both peers agree on (e.g. for the session key salt).
+     */
+    friend bool operator<(const ClientId& a, const ClientId& b) { return std::memcmp(a._bytes.data(), b._bytes.data(), SIZE) < 0; }
+
+private:
+    std::array<uint8_t, SIZE> _bytes;
+};
+
+namespace std {
+    template <>
+    struct hash<ClientId> {
+        size_t operator()(const ClientId& id) const noexcept { return static_cast<size_t>(id.hash()); }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,472 @@
+﻿#include "Codec.h"
+
+#include <array>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CODEC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC compiles the intrinsics of any instruction set without extra flags.
+#define CODEC_TARGET(features)
+#else
+// The SIMD functions are compiled for their instruction set only; they are called after a CPU check.
+#define CODEC_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Values of the Base64 characters; the markers are above 63.
+static const uint8_t BASE64_INVALID = 0xFF;
+static const uint8_t BASE64_WHITESPACE = 0xFE;
+static const uint8_t BASE64_PADDING = 0xFD;
+
+static constexpr std::array<uint8_t, 256> makeBase64Values() {
+    std::array<uint8_t, 256> values{};
+    for (uint8_t& value : values) {
+        value = BASE64_INVALID;
+    }
+    for (int i = 0; i < 64; i++) {
+        values[static_cast<uint8_t>(BASE64_ALPHABET[i])] = static_cast<uint8_t>(i);
+    }
+    for (char c : { ' ', '\t', '\r', '\n' }) {
+        values[static_cast<uint8_t>(c)] = BASE64_WHITESPACE;
+    }
+    values['='] = BASE64_PADDING;
+    return values;
+}
+
+static constexpr std::array<uint8_t, 256> BASE64_VALUES = makeBase64Values();
+
+static int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// -----------------------------
+// Scalar
+// -----------------------------
+static size_t base64EncodeScalar(const uint8_t* data, size_t length, char* out) {
+    char* start = out;
+    size_t i = 0;
+    for (; length - i >= 3; i += 3) {
+        uint32_t triple = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        *out++ = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+        *out++ = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+        *out++ = BASE64_ALPHABET[(triple >> 6) & 0x3F];
+        *out++ = BASE64_ALPHABET[triple & 0x3F];
+    }
+    if (i < length) {
+        uint32_t triple = data[i] << 16;
+        if (length - i == 2) {
+            triple |= data[i + 1] << 8;
+        }
+        *out++ = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+        *out++ = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+        *out++ = (length - i == 2) ? BASE64_ALPHABET[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+    return out - start;
+}
+
+static size_t base64DecodeScalar(const char* text, size_t length, uint8_t* out, size_t outSize) {
+    size_t written = 0;
+    uint32_t quad = 0;
+    int count = 0;   // characters collected in quad
+    int padding = 0; // '=' seen so far
+    auto put = [&](uint8_t byte) {
+        if (written == outSize) {
+            throw std::length_error("Base64 output buffer is too small");
+        }
+        out[written++] = byte;
+    };
+    for (size_t i = 0; i < length; i++) {
+        uint8_t value = BASE64_VALUES[static_cast<uint8_t>(text[i])];
+        if (value == BASE64_WHITESPACE) {
+            continue;
+        }
+        if (value == BASE64_PADDING) {
+            // Padding may only complete the last group of 2 or 3 characters.
+            if (count + padding < 2 || count + padding >= 4) {
+                throw std::invalid_argument("Misplaced padding in Base64 text");
+            }
+            padding++;
+            continue;
+        }
+        if (value == BASE64_INVALID || padding > 0) {
+            throw std::invalid_argument("Invalid character in Base64 text");
+        }
+        quad = (quad << 6) | value;
+        if (++count == 4) {
+            put(static_cast<uint8_t>(quad >> 16));
+            put(static_cast<uint8_t>(quad >> 8));
+            put(static_cast<uint8_t>(quad));
+            quad = 0;
+            count = 0;
+        }
+    }
+    if (count == 1) {
+        throw std::invalid_argument("Base64 text ends with a dangling character");
+    }
+    if (count == 2) {
+        put(static_cast<uint8_t>(quad >> 4));
+    }
+    else if (count == 3) {
+        put(static_cast<uint8_t>(quad >> 10));
+        put(static_cast<uint8_t>(quad >> 2));
+    }
+    return written;
+}
+
+static void hexEncodeScalar(const uint8_t* data, size_t length, char* out) {
+    for (size_t i = 0; i < length; i++) {
+        out[2 * i] = HEX_DIGITS[data[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[data[i] & 0x0F];
+    }
+}
+
+static void hexDecodeScalar(const char* text, size_t length, uint8_t* out) {
+    for (size_t i = 0; i < length / 2; i++) {
+        int high = hexDigitValue(text[2 * i]);
+        int low = hexDigitValue(text[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            throw std::invalid_argument("Invalid character in hex string");
+        }
+        out[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+}
+
+#ifdef CODEC_X86
+// -----------------------------
+// SIMD
+// -----------------------------
+// The Base64 kernels follow Mula and Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions". The loops stop at the first block they can't take whole (the tail, padding,
+// whitespace or an invalid character) and leave the rest to the scalar code.
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool avx2 = false;
+};
+
+static CpuFeatures detectCpuFeatures() {
+    CpuFeatures features;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.sse2 = ((info[3] >> 26) & 1) != 0;
+    features.ssse3 = ((info[2] >> 9) & 1) != 0;
+    // AVX2 also needs the OS to save the YMM registers.
+    bool osSavesYmm = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = osSavesYmm && ((info[1] >> 5) & 1);
+    }
+#else
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.ssse3 = __builtin_cpu_supports("ssse3");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return features;
+}
+
+static const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+// Splits 12 bytes, as [b1 b0 b2 b1] per 32-bit lane, into sixteen 6-bit indices.
+CODEC_TARGET("ssse3")
+static inline __m128i base64SplitSsse3(__m128i in) {
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+// Maps 6-bit indices to the alphabet by adding a per-range offset.
+CODEC_TARGET("ssse3")
+static inline __m128i base64LookupSsse3(__m128i indices) {
+    __m128i ranges = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    ranges = _mm_or_si128(ranges, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, ranges), indices);
+}
+
+CODEC_TARGET("ssse3")
+static size_t base64EncodeSsse3(const uint8_t* data, size_t length, char* out) {
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    size_t i = 0;
+    // Each step reads 16 bytes and uses 12 of them.
+    for (; length - i >= 16; i += 12) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), spread);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), base64LookupSsse3(base64SplitSsse3(in)));
+        out += 16;
+    }
+    return i;
+}
+
+CODEC_TARGET("avx2")
+static size_t base64EncodeAvx2(const uint8_t* data, size_t length, char* out) {
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    // Each step reads bytes 0..15 and 12..27 into the two lanes and uses 24 of them.
+    for (; length - i >= 28; i += 24) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 12)), 1);
+        in = _mm256_shuffle_epi8(in, spread);
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+        __m256i ranges = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        ranges = _mm256_or_si256(ranges, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, ranges), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), chars);
+        out += 32;
+    }
+    return i;
+}
+
+// Decodes 16 characters to 6-bit values in place; returns false if any is not in the alphabet.
+CODEC_TARGET("ssse3")
+static inline bool base64TranslateSsse3(__m128i& chars) {
+    const __m128i lowLookup = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i highLookup = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+    __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask2F);
+    __m128i lowNibbles = _mm_and_si128(chars, mask2F);
+    __m128i low = _mm_shuffle_epi8(lowLookup, lowNibbles);
+    __m128i high = _mm_shuffle_epi8(highLookup, highNibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+    // '/' shares its high nibble with '+'; it is told apart by the compare.
+    __m128i isSlash = _mm_cmpeq_epi8(chars, mask2F);
+    chars = _mm_add_epi8(chars, _mm_shuffle_epi8(offsets, _mm_add_epi8(isSlash, highNibbles)));
+    return true;
+}
+
+// Packs sixteen 6-bit values into 12 bytes at the start of the register.
+CODEC_TARGET("ssse3")
+static inline __m128i base64PackSsse3(__m128i values) {
+    __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i triples = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(triples, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+CODEC_TARGET("ssse3")
+static void base64DecodeSsse3(const char* text, size_t length, uint8_t* out, size_t outSize, size_t& consumed, size_t& written) {
+    // Each step reads 16 characters and stores 16 bytes, of which 12 are decoded.
+    while (length - consumed >= 16 && outSize - written >= 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + consumed));
+        if (!base64TranslateSsse3(chars)) {
+            return;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), base64PackSsse3(chars));
+        consumed += 16;
+        written += 12;
+    }
+}
+
+CODEC_TARGET("avx2")
+static void base64DecodeAvx2(const char* text, size_t length, uint8_t* out, size_t outSize, size_t& consumed, size_t& written) {
+    const __m256i lowLookup = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i highLookup = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i offsets = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    // Each step reads 32 characters and stores 32 bytes, of which 24 are decoded.
+    while (length - consumed >= 32 && outSize - written >= 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + consumed));
+        __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask2F);
+        __m256i lowNibbles = _mm256_and_si256(chars, mask2F);
+        __m256i low = _mm256_shuffle_epi8(lowLookup, lowNibbles);
+        __m256i high = _mm256_shuffle_epi8(highLookup, highNibbles);
+        if (!_mm256_testz_si256(low, high)) {
+            return;
+        }
+        __m256i isSlash = _mm256_cmpeq_epi8(chars, mask2F);
+        chars = _mm256_add_epi8(chars, _mm256_shuffle_epi8(offsets, _mm256_add_epi8(isSlash, highNibbles)));
+        __m256i pairs = _mm256_maddubs_epi16(chars, _mm256_set1_epi32(0x01400140));
+        __m256i triples = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        // 12 bytes at the start of each lane; moved together into the low 24 bytes.
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(triples, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written), bytes);
+        consumed += 32;
+        written += 24;
+    }
+}
+
+// Nibbles 0..15 to '0'..'9', 'a'..'f'.
+CODEC_TARGET("sse2")
+static inline __m128i hexDigitsSse2(__m128i nibbles) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+CODEC_TARGET("sse2")
+static size_t hexEncodeSse2(const uint8_t* data, size_t length, char* out) {
+    const __m128i mask0F = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; length - i >= 16; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(in, 4), mask0F);
+        __m128i low = _mm_and_si128(in, mask0F);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), hexDigitsSse2(_mm_unpacklo_epi8(high, low)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16), hexDigitsSse2(_mm_unpackhi_epi8(high, low)));
+    }
+    return i;
+}
+
+// Decodes 16 hex characters to nibbles in place; returns false if any is not a hex digit.
+CODEC_TARGET("sse2")
+static inline bool hexNibblesSse2(__m128i& chars) {
+    __m128i digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i letters = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    // Unsigned range checks: x <= n exactly when max(x, n) == n.
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_max_epu8(digits, _mm_set1_epi8(9)), _mm_set1_epi8(9));
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_max_epu8(letters, _mm_set1_epi8(5)), _mm_set1_epi8(5));
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF) {
+        return false;
+    }
+    chars = _mm_or_si128(_mm_and_si128(isDigit, digits), _mm_andnot_si128(isDigit, _mm_add_epi8(letters, _mm_set1_epi8(10))));
+    return true;
+}
+
+CODEC_TARGET("sse2")
+static size_t hexDecodeSse2(const char* text, size_t length, uint8_t* out) {
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+    for (; length - i >= 32; i += 32) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 16));
+        if (!hexNibblesSse2(first) || !hexNibblesSse2(second)) {
+            break;
+        }
+        // Each 16-bit lane holds [high nibble][low nibble]; join them into one byte.
+        first = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(first, lowBytes), 4), _mm_srli_epi16(first, 8));
+        second = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(second, lowBytes), 4), _mm_srli_epi16(second, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 2), _mm_packus_epi16(first, second));
+    }
+    return i;
+}
+#endif
+
+// -----------------------------
+// Public interface
+// -----------------------------
+size_t Codec::base64Encode(const void* data, size_t length, char* out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t done = 0;
+#ifdef CODEC_X86
+    if (cpuFeatures().avx2) {
+        done = base64EncodeAvx2(bytes, length, out);
+    }
+    if (cpuFeatures().ssse3) {
+        done += base64EncodeSsse3(bytes + done, length - done, out + done / 3 * 4);
+    }
+#endif
+    return done / 3 * 4 + base64EncodeScalar(bytes + done, length - done, out + done / 3 * 4);
+}
+
+size_t Codec::base64Decode(const char* text, size_t length, void* out, size_t outSize) {
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    size_t consumed = 0;
+    size_t written = 0;
+#ifdef CODEC_X86
+    if (cpuFeatures().avx2) {
+        base64DecodeAvx2(text, length, bytes, outSize, consumed, written);
+    }
+    if (cpuFeatures().ssse3) {
+        base64DecodeSsse3(text, length, bytes, outSize, consumed, written);
+    }
+#endif
+    return written + base64DecodeScalar(text + consumed, length - consumed, bytes + written, outSize - written);
+}
+
+size_t Codec::hexEncode(const void* data, size_t length, char* out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t done = 0;
+#ifdef CODEC_X86
+    if (cpuFeatures().sse2) {
+        done = hexEncodeSse2(bytes, length, out);
+    }
+#endif
+    hexEncodeScalar(bytes + done, length - done, out + 2 * done);
+    return 2 * length;
+}
+
+size_t Codec::hexDecode(const char* text, size_t length, void* out, size_t outSize) {
+    if (length % 2 != 0) {
+        throw std::invalid_argument("Hex string has an odd length");
+    }
+    if (outSize < length / 2) {
+        throw std::length_error("Hex output buffer is too small");
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    size_t done = 0;
+#ifdef CODEC_X86
+    if (cpuFeatures().sse2) {
+        done = hexDecodeSse2(text, length, bytes);
+    }
+#endif
+    hexDecodeScalar(text + done, length - done, bytes + done / 2);
+    return length / 2;
+}
+
+std::string Codec::base64Encode(std::string_view bytes) {
+    std::string text(base64EncodedSize(bytes.size()), '\0');
+    text.resize(base64Encode(bytes.data(), bytes.size(), text.data()));
+    return text;
+}
+
+std::string Codec::base64Decode(std::string_view text) {
+    std::string bytes(base64MaxDecodedSize(text.size()), '\0');
+    bytes.resize(base64Decode(text.data(), text.size(), bytes.data(), bytes.size()));
+    return bytes;
+}
+
+std::string Codec::hexEncode(std::string_view bytes) {
+    std::string text(hexEncodedSize(bytes.size()), '\0');
+    hexEncode(bytes.data(), bytes.size(), text.data());
+    return text;
+}
+
+std::string Codec::hexDecode(std::string_view text) {
+    std::string bytes(text.size() / 2, '\0');
+    bytes.resize(hexDecode(text.data(), text.size(), bytes.data(), bytes.size()));
+    return bytes;
+}
\ No newline at end of file
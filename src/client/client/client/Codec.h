@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+/**
+ * @brief Base64 and hexadecimal encoding and decoding into caller-provided buffers.
+ *
+ * On x86, long inputs are converted 16 or 32 bytes at a time with SSE2, SSSE3 or AVX2, whichever
+ * the CPU supports (checked once, at run time); other CPUs and the tails of the inputs take the
+ * scalar path, which gives the same results.
+ *
+ * Base64 uses the standard alphabet with '=' padding and is written on one line. The decoder skips
+ * whitespace, so text split over several lines (as Crypto++'s Base64Encoder writes it) decodes
+ * too, and accepts unpadded input. Hex is written in lower case; both cases are decoded.
+ */
+class Codec {
+public:
+    /**
+     * @brief Length of the Base64 text of \p length bytes.
+     */
+    static constexpr size_t base64EncodedSize(size_t length) { return (length + 2) / 3 * 4; }
+
+    /**
+     * @brief Upper bound of the number of bytes decoded from \p length characters of Base64.
+     */
+    static constexpr size_t base64MaxDecodedSize(size_t length) { return length / 4 * 3 + 2; }
+
+    /**
+     * @brief Length of the hex text of \p length bytes.
+     */
+    static constexpr size_t hexEncodedSize(size_t length) { return 2 * length; }
+
+    /**
+     * @brief Encodes \p length bytes as Base64.
+     *
+     * @param out Receives base64EncodedSize(length) characters; no terminator is written.
+     * @return The number of characters written.
+     */
+    static size_t base64Encode(const void* data, size_t length, char* out);
+
+    /**
+     * @brief Decodes Base64 text.
+     *
+     * @param out Receives the decoded bytes; base64MaxDecodedSize(length) bytes are always enough.
+     * @return The number of bytes written.
+     *
+     * @throws std::invalid_argument if the text has a character outside the alphabet, misplaced
+     *         padding or a dangling character.
+     * @throws std::length_error if the decoded bytes do not fit in \p outSize bytes.
+     */
+    static size_t base64Decode(const char* text, size_t length, void* out, size_t outSize);
+
+    /**
+     * @brief Encodes \p length bytes as lower-case hex.
+     *
+     * @param out Receives hexEncodedSize(length) characters; no terminator is written.
+     * @return The number of characters written.
+     */
+    static size_t hexEncode(const void* data, size_t length, char* out);
+
+    /**
+     * @brief Decodes hex text; upper- and lower-case digits are accepted.
+     *
+     * @param out Receives length / 2 bytes.
+     * @return The number of bytes written.
+     *
+     * @throws std::invalid_argument if the text has an odd length or a non-hex character.
+     * @throws std::length_error if the decoded bytes do not fit in \p outSize bytes.
+     */
+    static size_t hexDecode(const char* text, size_t length, void* out, size_t outSize);
+
+    /**
+     * @brief String forms of the functions above, for display and the me.info file.
+     */
+    static std::string base64Encode(std::string_view bytes);
+    static std::string base64Decode(std::string_view text);
+    static std::string hexEncode(std::string_view bytes);
+    static std::string hexDecode(std::string_view text);
+};
\ No newline at end of file
@@ -0,0 +1,66 @@
+﻿#include "ConnectionPool.h"
+
+
+ConnectionPool::ConnectionPool(const std::string& serverIp, unsigned short serverPort, const ConnectionPoolConfig& config)
+    : _serverIp(serverIp), _serverPort(serverPort), _config(config) {
+    _idle.reserve(_config.poolSize);
+}
+
+ConnectionPool::~ConnectionPool() {
+    clear();
+}
+
+// Only starts the connects, so a slow or unreachable server never holds up the caller.
+void ConnectionPool::warmUp() {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (_idle.size() < _config.poolSize) {
+        try {
+            _idle.push_back({ connect(), now });
+        }
+        catch (const std::runtime_error&) {
+            // The server is not reachable right now; connections will be opened on demand.
+            return;
+        }
+    }
+}
+
+std::unique_ptr<SocketWrapper> ConnectionPool::tryAcquireIdle() {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (!_idle.empty()) {
+        IdleConnection candidate = std::move(_idle.back());
+        _idle.pop_back();
+        // Expired or closed connections are dropped (their sockets close on destruction).
+        if (now - candidate.idleSince > _config.idleTimeout) {
+            continue;
+        }
+        if (_config.healthCheck && !candidate.socket->isAlive()) {
+            continue;
+        }
+        return std::move(candidate.socket);
+    }
+    return nullptr;
+}
+
+void ConnectionPool::release(std::unique_ptr<SocketWrapper> socket) {
+    if (!socket || !socket->isValid()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_idle.size() < _config.poolSize) {
+        _idle.push_back({ std::move(socket), std::chrono::steady_clock::now() });
+    }
+}
+
+void ConnectionPool::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _idle.clear();
+}
+
+std::unique_ptr<SocketWrapper> ConnectionPool::connect() const {
+    auto socket = std::make_unique<SocketWrapper>(_serverIp, _serverPort);
+    // Requests are small and latency-bound, so they must not wait for Nagle coalescing.
+    socket->setNoDelay(true);
+    return socket;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+﻿#pragma once
+#include "utils.h"
+#include "SocketWrapper.h"
+#include <chrono>
+#include <mutex>
+
+
+/**
+ * @brief Settings of the client connection pool.
+ *
+ * The values can be given as optional "key=value" lines after the address line in server.info:
+ * - poolSize: number of connections kept open and pre-connected (default 1).
+ * - idleTimeout: seconds an unused connection is kept before it is closed (default 30).
+ * - healthCheck: 1 to check that an idle connection is still open before handing it out, 0 to skip (default 1).
+ */
+struct ConnectionPoolConfig {
+    size_t poolSize = 1;                         ///< Number of idle connections kept open.
+    std::chrono::seconds idleTimeout{ 30 };      ///< How long an unused connection may stay in the pool.
+    bool healthCheck = true;                     ///< Whether idle connections are checked before reuse.
+};
+
+
+/**
+ * @brief A small pool of pre-connected sockets to the server.
+ *
+ * The pool keeps up to poolSize sockets with TCP_NODELAY set. Each request acquires one
+ * socket and releases it again once the response has been read, so consecutive requests skip the
+ * TCP connect. Sockets idle for longer than idleTimeout, or found closed by the health check, are
+ * dropped and replaced by new connections. All methods are thread-safe.
+ */
+class ConnectionPool {
+public:
+    /**
+     * @brief Constructs a pool for the given server endpoint.
+     *
+     * No connection is opened until warmUp or connect is called.
+     *
+     * @param serverIp The IP address of the server.
+     * @param serverPort The port number of the server.
+     * @param config The pool settings.
+     */
+    ConnectionPool(const std::string& serverIp, unsigned short serverPort, const ConnectionPoolConfig& config);
+
+    /**
+     * @brief Destroys the pool and closes all idle connections.
+     */
+    ~ConnectionPool();
+
+    /**
+     * @brief Starts connections until the pool holds poolSize idle sockets.
+     *
+     * The connects are only started, so this call never blocks: a socket handed out by
+     * tryAcquireIdle may still be connecting and must be completed with SocketWrapper::connectAsync
+     * before use. This is best-effort: if a connect cannot even be started, the pool simply stays
+     * smaller and connections are opened on demand.
+     */
+    void warmUp();
+
+    /**
+     * @brief Hands out an idle socket without ever opening a new connection.
+     *
+     * Returns the most recently used idle socket that has not expired and passes the health check.
+     * This call never blocks.
+     *
+     * @return A socket owned by the caller (possibly still connecting, see warmUp), or null if no
+     *         usable idle socket is left.
+     */
+    std::unique_ptr<SocketWrapper> tryAcquireIdle();
+
+    /**
+     * @brief Starts a new connection with the pool's socket options applied.
+     *
+     * @return The new socket, owned by the caller; its connect is still in progress and must be
+     *         completed with SocketWrapper::connectAsync.
+     *
+     * @throws std::runtime_error if the connect cannot be started.
+     */
+    std::unique_ptr<SocketWrapper> connect() const;
+
+    /**
+     * @brief Returns a socket to the pool after a completed request.
+     *
+     * The socket is closed instead if the pool is already full.
+     *
+     * @param socket The socket to return; it must not have any unread data pending.
+     */
+    void release(std::unique_ptr<SocketWrapper> socket);
+
+    /**
+     * @brief Closes all idle connections.
+     */
+    void clear();
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<SocketWrapper> socket;           ///< The connected socket.
+        std::chrono::steady_clock::time_point idleSince; ///< When the socket was returned to the pool.
+    };
+
+    std::string _serverIp;                 ///< Server IP address.
+    unsigned short _serverPort;            ///< Server port number.
+    ConnectionPoolConfig _config;          ///< Pool settings.
+    std::vector<IdleConnection> _idle;     ///< Idle connections, most recently used last.
+    std::mutex _mutex;                     ///< Guards _idle.
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "CryptoContext.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+CryptoContext::SharedRng::SharedRng() : _available(0)
+{
+}
+
+CryptoContext::SharedRng::~SharedRng()
+{
+	std::fill(_buffer, _buffer + BUFFER_SIZE, 0);
+}
+
+void CryptoContext::SharedRng::GenerateBlock(CryptoPP::byte* output, size_t size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	while (size > 0)
+	{
+		if (_available == 0)
+		{
+			// Large requests skip the buffer.
+			if (size >= BUFFER_SIZE)
+			{
+				_pool.GenerateBlock(output, size);
+				return;
+			}
+			_pool.GenerateBlock(_buffer, BUFFER_SIZE);
+			_available = BUFFER_SIZE;
+		}
+		// Bytes are served once, and wiped as they are handed out.
+		size_t count = std::min(size, _available);
+		CryptoPP::byte* source = _buffer + BUFFER_SIZE - _available;
+		std::memcpy(output, source, count);
+		std::fill(source, source + count, 0);
+		_available -= count;
+		output += count;
+		size -= count;
+	}
+}
+
+CryptoContext::CryptoContext()
+{
+}
+
+CryptoContext::~CryptoContext()
+{
+	std::fill(_sessionKeys.begin(), _sessionKeys.end(), 0);
+}
+
+CryptoContext& CryptoContext::instance()
+{
+	static CryptoContext context;
+	return context;
+}
+
+void CryptoContext::takeSessionKey(unsigned char* key)
+{
+	std::lock_guard<std::mutex> lock(_sessionKeysMutex);
+	if (_sessionKeys.empty())
+	{
+		_sessionKeys.resize(SESSION_KEY_BATCH * SESSION_KEY_SIZE);
+		_rng.GenerateBlock(_sessionKeys.data(), _sessionKeys.size());
+	}
+	CryptoPP::byte* last = _sessionKeys.data() + _sessionKeys.size() - SESSION_KEY_SIZE;
+	std::memcpy(key, last, SESSION_KEY_SIZE);
+	std::fill(last, last + SESSION_KEY_SIZE, 0);
+	_sessionKeys.resize(_sessionKeys.size() - SESSION_KEY_SIZE);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <osrng.h>
+
+#include <mutex>
+#include <vector>
+
+
+
+// Process-wide randomness for the crypto wrappers: one RNG, seeded from the OS once, that any thread
+// may draw from, and a pool of pre-generated AES session keys.
+class CryptoContext
+{
+public:
+	static const size_t BUFFER_SIZE = 4096;			// random bytes generated per refill of the RNG buffer
+	static const size_t SESSION_KEY_SIZE = 16;
+	static const size_t SESSION_KEY_BATCH = 64;		// session keys generated per refill of the pool
+
+private:
+	// Hands out the output of one AutoSeededRandomPool from a buffer, under a lock.
+	class SharedRng : public CryptoPP::RandomNumberGenerator
+	{
+	public:
+		SharedRng();
+		~SharedRng();
+		void GenerateBlock(CryptoPP::byte* output, size_t size) override;
+
+	private:
+		std::mutex _mutex;
+		CryptoPP::AutoSeededRandomPool _pool;
+		CryptoPP::byte _buffer[BUFFER_SIZE];
+		size_t _available;		// unused bytes at the end of _buffer
+	};
+
+	SharedRng _rng;
+	std::mutex _sessionKeysMutex;
+	std::vector<CryptoPP::byte> _sessionKeys;	// unused keys, SESSION_KEY_SIZE bytes each
+
+	CryptoContext();
+	CryptoContext(const CryptoContext& context);
+	CryptoContext& operator=(const CryptoContext& context);
+public:
+	~CryptoContext();
+
+	static CryptoContext& instance();
+
+	// The shared RNG, for Crypto++ calls that take one. Thread-safe.
+	CryptoPP::RandomNumberGenerator& rng() { return _rng; }
+
+	void generateBlock(unsigned char* output, size_t length) { _rng.GenerateBlock(output, length); }
+
+	// Copies a new session key (SESSION_KEY_SIZE bytes) to key. Each key is handed out once.
+	void takeSessionKey(unsigned char* key);
+};
\ No newline at end of file
@@ -0,0 +1,167 @@
+﻿#include "EventLoop.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+
+// Converts READABLE/WRITABLE flags to the matching epoll event mask.
+static uint32_t toEpollEvents(uint32_t events) {
+    uint32_t mask = 0;
+    if (events & EventLoop::READABLE) {
+        mask |= EPOLLIN;
+    }
+    if (events & EventLoop::WRITABLE) {
+        mask |= EPOLLOUT;
+    }
+    return mask;
+}
+#endif
+
+
+EventLoop::EventLoop() {
+#ifdef __linux__
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epollFd < 0) {
+        throw std::runtime_error("Failed to create epoll instance: " + std::to_string(errno));
+    }
+#endif
+}
+
+EventLoop::~EventLoop() {
+#ifdef __linux__
+    close(_epollFd);
+#endif
+}
+
+void EventLoop::watch(SOCKET socket, uint32_t events, Handler handler) {
+    auto it = _watches.find(socket);
+#ifdef __linux__
+    epoll_event event = {};
+    event.events = toEpollEvents(events);
+    event.data.fd = socket;
+    int operation = (it == _watches.end()) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    int result = epoll_ctl(_epollFd, operation, socket, &event);
+    if (result < 0 && operation == EPOLL_CTL_MOD && errno == ENOENT) {
+        // The descriptor was closed and reused without being unwatched first.
+        result = epoll_ctl(_epollFd, EPOLL_CTL_ADD, socket, &event);
+    }
+    if (result < 0) {
+        throw std::runtime_error("Failed to register socket with epoll: " + std::to_string(errno));
+    }
+#endif
+    if (it == _watches.end()) {
+        _watches.emplace(socket, Watch{ events, std::move(handler) });
+    }
+    else {
+        it->second.events = events;
+        it->second.handler = std::move(handler);
+    }
+}
+
+void EventLoop::unwatch(SOCKET socket) {
+    auto it = _watches.find(socket);
+    if (it == _watches.end()) {
+        return;
+    }
+#ifdef __linux__
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, socket, NULL);
+#endif
+    _watches.erase(it);
+}
+
+void EventLoop::post(Callback callback) {
+    _posted.push_back(std::move(callback));
+}
+
+bool EventLoop::empty() const {
+    return _watches.empty() && _posted.empty();
+}
+
+size_t EventLoop::runOnce(int timeoutMs) {
+    // Callbacks posted while this round runs belong to the next round.
+    std::vector<Callback> posted;
+    posted.swap(_posted);
+    size_t dispatched = 0;
+    for (Callback& callback : posted) {
+        callback();
+        dispatched++;
+    }
+    if (_watches.empty()) {
+        return dispatched;
+    }
+    if (dispatched > 0 || !_posted.empty()) {
+        timeoutMs = 0;
+    }
+
+    // Collect the ready sockets first: handlers may change the registrations while they run.
+    std::vector<std::pair<SOCKET, uint32_t>> ready;
+#ifdef __linux__
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(_epollFd, events, MAX_EVENTS, timeoutMs);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return dispatched;
+        }
+        throw std::runtime_error("epoll_wait failed: " + std::to_string(errno));
+    }
+    ready.reserve(count);
+    for (int i = 0; i < count; i++) {
+        uint32_t occurred = 0;
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            occurred |= READABLE;
+        }
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            occurred |= WRITABLE;
+        }
+        SOCKET socket = events[i].data.fd;
+        ready.emplace_back(socket, occurred);
+    }
+#else
+    _pollSet.clear();
+    for (const auto& entry : _watches) {
+        SocketPollFd fd = {};
+        fd.fd = entry.first;
+        fd.events = static_cast<short>(((entry.second.events & READABLE) ? POLLIN : 0) |
+            ((entry.second.events & WRITABLE) ? POLLOUT : 0));
+        _pollSet.push_back(fd);
+    }
+    int count = pollSockets(_pollSet.data(), _pollSet.size(), timeoutMs);
+    if (count < 0) {
+        throw std::runtime_error("Polling sockets failed: " + std::to_string(lastSocketError()));
+    }
+    for (const SocketPollFd& fd : _pollSet) {
+        uint32_t occurred = 0;
+        if (fd.revents & (POLLIN | POLLERR | POLLHUP)) {
+            occurred |= READABLE;
+        }
+        if (fd.revents & (POLLOUT | POLLERR | POLLHUP)) {
+            occurred |= WRITABLE;
+        }
+        if (occurred != 0) {
+            ready.emplace_back(fd.fd, occurred);
+        }
+    }
+#endif
+
+    for (const auto& item : ready) {
+        auto it = _watches.find(item.first);
+        if (it == _watches.end()) {
+            continue; // Unregistered by an earlier handler in this round.
+        }
+        uint32_t occurred = item.second & it->second.events;
+        if (occurred == 0) {
+            continue;
+        }
+        // Keep a copy: the handler may replace or remove its own registration.
+        Handler handler = it->second.handler;
+        handler(occurred);
+        dispatched++;
+    }
+    return dispatched;
+}
+
+void EventLoop::run() {
+    while (!empty()) {
+        runOnce(-1);
+    }
+}
\ No newline at end of file
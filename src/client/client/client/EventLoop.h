@@ -0,0 +1,116 @@
+﻿#pragma once
+#include "utils.h"
+#include <functional>
+
+
+/**
+ * @brief A single-threaded readiness event loop for sockets.
+ *
+ * Sockets are registered with the events they wait for (readable and/or writable) and a handler
+ * that is called from runOnce/run when one of those events occurs. On Linux the loop is backed by
+ * epoll; on other platforms (Windows) it falls back to polling the registered sockets with
+ * WSAPoll/poll. One thread can drive any number of in-flight socket operations this way.
+ *
+ * Handlers may register, modify or unregister sockets (including their own) while being called.
+ * Callbacks can also be posted to run on the next round, which is how coroutines are resumed
+ * outside of the code that completed them. The loop is not thread-safe: all calls must come
+ * from the thread that runs it.
+ */
+class EventLoop {
+public:
+    static const uint32_t READABLE = 1; ///< The socket has data to read (or was closed by the peer).
+    static const uint32_t WRITABLE = 2; ///< The socket can accept more data (or a connect completed).
+
+    /**
+     * @brief Handler called with the subset of READABLE/WRITABLE that occurred.
+     *
+     * Errors and hang-ups are reported as the events the socket was waiting for, so the
+     * following socket call returns the actual error.
+     */
+    using Handler = std::function<void(uint32_t events)>;
+
+    /**
+     * @brief Callback queued with post.
+     */
+    using Callback = std::function<void()>;
+
+    /**
+     * @brief Constructs an empty event loop.
+     *
+     * @throws std::runtime_error if the epoll instance cannot be created.
+     */
+    EventLoop();
+
+    /**
+     * @brief Destroys the event loop. Registered sockets are not closed.
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief Registers a socket, or replaces the events and handler of an already registered one.
+     *
+     * @param socket The socket to watch.
+     * @param events A combination of READABLE and WRITABLE.
+     * @param handler The handler to call when one of the events occurs.
+     *
+     * @throws std::runtime_error if the socket cannot be registered.
+     */
+    void watch(SOCKET socket, uint32_t events, Handler handler);
+
+    /**
+     * @brief Unregisters a socket. Does nothing if the socket is not registered.
+     *
+     * @param socket The socket to stop watching.
+     */
+    void unwatch(SOCKET socket);
+
+    /**
+     * @brief Queues a callback to be called on the next round of the loop.
+     *
+     * A pending callback makes the next runOnce return without waiting for socket events.
+     *
+     * @param callback The callback to call.
+     */
+    void post(Callback callback);
+
+    /**
+     * @brief Checks whether no socket is registered and no callback is pending.
+     *
+     * @return true if there is nothing left to wait for.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Waits for events once and calls the handlers of the sockets that are ready.
+     *
+     * Posted callbacks are called first, in the order they were posted.
+     *
+     * @param timeoutMs The maximum time to wait in milliseconds, or -1 to wait indefinitely.
+     * @return The number of handlers and callbacks that were called (0 on timeout).
+     *
+     * @throws std::runtime_error if waiting for events fails.
+     */
+    size_t runOnce(int timeoutMs = -1);
+
+    /**
+     * @brief Runs the loop until no socket is registered and no callback is pending any more.
+     */
+    void run();
+
+private:
+    struct Watch {
+        uint32_t events; ///< Events the socket waits for.
+        Handler handler; ///< Handler to call when they occur.
+    };
+
+    std::unordered_map<SOCKET, Watch> _watches; ///< Registered sockets.
+    std::vector<Callback> _posted;              ///< Callbacks for the next round, in order.
+#ifdef __linux__
+    int _epollFd;                               ///< The epoll instance.
+#else
+    std::vector<SocketPollFd> _pollSet;         ///< Poll set rebuilt on every runOnce.
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,87 @@
+﻿#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_file, &fileSize)) {
+        CloseHandle(_file);
+        throw std::runtime_error("Cannot read the size of file: " + path);
+    }
+    _size = static_cast<size_t>(fileSize.QuadPart);
+    if (_size == 0) {
+        return; // An empty file cannot be mapped; there is nothing to read anyway.
+    }
+
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mapping != NULL) {
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (_data == nullptr) {
+        if (_mapping != NULL) {
+            CloseHandle(_mapping);
+        }
+        CloseHandle(_file);
+        throw std::runtime_error("Cannot map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != NULL) {
+        CloseHandle(_mapping);
+    }
+    CloseHandle(_file);
+}
+#else
+MappedFile::MappedFile(const std::string& path) : _data(nullptr), _size(0), _fd(-1) {
+    _fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    struct stat fileStat;
+    if (fstat(_fd, &fileStat) != 0) {
+        close(_fd);
+        throw std::runtime_error("Cannot read the size of file: " + path);
+    }
+    _size = static_cast<size_t>(fileStat.st_size);
+    if (_size == 0) {
+        return; // An empty file cannot be mapped; there is nothing to read anyway.
+    }
+
+    void* view = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (view == MAP_FAILED) {
+        close(_fd);
+        throw std::runtime_error("Cannot map file: " + path);
+    }
+    // The file is read front to back exactly once.
+    madvise(view, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(view);
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+    close(_fd);
+}
+#endif
+
+const char* MappedFile::data() const {
+    return _data;
+}
+
+size_t MappedFile::size() const {
+    return _size;
+}
\ No newline at end of file
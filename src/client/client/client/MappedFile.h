@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "utils.h"
+
+
+/**
+ * @brief A read-only memory mapping of a whole file.
+ *
+ * The file is mapped with CreateFileMapping/MapViewOfFile on Windows and mmap on POSIX systems,
+ * so its bytes can be read (e.g. encrypted chunk by chunk) without copying the file into memory.
+ * The operating system pages the data in on demand and can drop it again, so reading a large file
+ * does not grow the process's heap.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Opens and maps the file.
+     *
+     * @param path The path of the file to map.
+     *
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string& path);
+
+    /**
+     * @brief Unmaps and closes the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Returns the first byte of the mapped file (null for an empty file).
+     */
+    const char* data() const;
+
+    /**
+     * @brief Returns the size of the file in bytes.
+     */
+    size_t size() const;
+
+private:
+    const char* _data; ///< Start of the mapped view; null for an empty file.
+    size_t _size;      ///< File size in bytes.
+#ifdef _WIN32
+    HANDLE _file;      ///< The open file.
+    HANDLE _mapping;   ///< The file mapping object.
+#else
+    int _fd;           ///< The open file descriptor.
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,60 @@
+﻿#include "MessageView.h"
+
+
+// From version 2 on, the version byte follows the type and pushes the content size back by one.
+static size_t recordHeaderSize(uint8_t version) {
+    return version >= 2 ? MessageRecords::RECORD_HEADER_SIZE_V2 : MessageRecords::RECORD_HEADER_SIZE;
+}
+
+static uint32_t recordContentSize(const uint8_t* record, uint8_t version) {
+    return version >= 2 ? Wire::MessageRecordV2::ContentSize::get(record) : Wire::MessageRecord::ContentSize::get(record);
+}
+
+MessageRecords::MessageRecords(std::span<const uint8_t> records, uint8_t version) : _records(records), _version(version) {
+    const size_t headerSize = recordHeaderSize(version);
+    size_t offset = 0;
+    while (offset < records.size()) {
+        if (records.size() - offset < headerSize) {
+            throw std::runtime_error("Truncated message header. Possibly corrupted data.");
+        }
+        uint32_t contentSize = recordContentSize(records.data() + offset, version);
+        if (contentSize > records.size() - offset - headerSize) {
+            throw std::runtime_error("Message size exceeds payload. Possibly corrupted data.");
+        }
+        _last = records.data() + offset;
+        _count++;
+        offset += headerSize + contentSize;
+    }
+}
+
+MessageRecords::Iterator::Iterator(const uint8_t* position, const uint8_t* end, uint8_t version)
+    : _position(position), _end(end), _version(version) {
+    decode();
+}
+
+MessageRecords::Iterator& MessageRecords::Iterator::operator++() {
+    _position += recordHeaderSize(_version) + _current.content.size();
+    decode();
+    return *this;
+}
+
+MessageRecords::Iterator MessageRecords::Iterator::operator++(int) {
+    Iterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+void MessageRecords::Iterator::decode() {
+    if (_position == _end) {
+        _current = {};
+        return;
+    }
+    // Both layouts start with the sender, the message ID and the type.
+    using Record = Wire::MessageRecord;
+    const char* record = reinterpret_cast<const char*>(_position);
+    _current.fromClientId = ClientId(_position + Record::FromClientId::offset);
+    _current.messageId = Record::MessageId::get(_position);
+    _current.type = Record::Type::get(_position);
+    _current.version = _version >= 2 ? Wire::MessageRecordV2::Version::get(_position) : 1;
+    _current.content = std::string_view(record + recordHeaderSize(_version), recordContentSize(_position, _version));
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+﻿#pragma once
+#include "ClientId.h"
+#include "WireSchema.h"
+
+
+/**
+ * @brief Non-owning view of one message record of a fetch response (2104, or 2107 after its flag byte).
+ *
+ * A record is [16 bytes sender ID][4 bytes message ID][1 byte type][4 bytes content size][content].
+ * In a version 2 response, [1 byte version] follows the type: the protocol version the message was
+ * sent with, which tells how its content is encrypted.
+ * The content points into the response payload, which must outlive it; the sender ID is copied.
+ */
+struct MessageView {
+    ClientId fromClientId;    ///< ID of the sender.
+    uint32_t messageId;       ///< Server-assigned message ID.
+    uint8_t type;             ///< Message type.
+    uint8_t version;          ///< Protocol version the message was sent with (1 in a version 1 response).
+    std::string_view content; ///< Message content (usually ciphertext).
+};
+
+/**
+ * @brief Range over the message records of a fetch response payload.
+ *
+ * The records are validated once, on construction; iterating then decodes each record header in
+ * place and never copies a content (the 16-byte sender ID is held by value).
+ *
+ * Example:
+ * @code
+ *   for (const MessageView& message : MessageRecords(payload)) {
+ *       display(message.fromClientId, message.content);
+ *   }
+ * @endcode
+ */
+class MessageRecords {
+public:
+    static const size_t RECORD_HEADER_SIZE = Wire::MessageRecord::SIZE;      // 25 bytes
+    static const size_t RECORD_HEADER_SIZE_V2 = Wire::MessageRecordV2::SIZE; // 26 bytes, with the version
+
+    /**
+     * @brief Forward iterator that yields a MessageView per record.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = MessageView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const MessageView*;
+        using reference = const MessageView&;
+
+        Iterator() = default;
+        Iterator(const uint8_t* position, const uint8_t* end, uint8_t version);
+
+        reference operator*() const { return _current; }
+        pointer operator->() const { return &_current; }
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const { return _position == other._position; }
+
+    private:
+        void decode();
+
+        const uint8_t* _position = nullptr; ///< Start of the current record (equal to _end past the last one).
+        const uint8_t* _end = nullptr;      ///< End of the records.
+        uint8_t _version = 1;               ///< Version of the response, which sets the record layout.
+        MessageView _current = {};          ///< The decoded current record.
+    };
+
+    /**
+     * @brief Creates an empty range.
+     */
+    MessageRecords() = default;
+
+    /**
+     * @brief Validates the records and creates a range over them.
+     *
+     * @param records The records, back to back (e.g. the whole 2104 payload).
+     * @param version The version of the response that carried them.
+     *
+     * @throws std::runtime_error if a record header or content is truncated.
+     */
+    explicit MessageRecords(std::span<const uint8_t> records, uint8_t version = 1);
+
+    Iterator begin() const { return Iterator(_records.data(), _records.data() + _records.size(), _version); }
+    Iterator end() const { return Iterator(_records.data() + _records.size(), _records.data() + _records.size(), _version); }
+
+    /**
+     * @brief Returns the number of records.
+     */
+    size_t size() const { return _count; }
+
+    bool empty() const { return _count == 0; }
+
+    /**
+     * @brief Returns the last record. The range must not be empty.
+     */
+    MessageView back() const { return *Iterator(_last, _records.data() + _records.size(), _version); }
+
+private:
+    std::span<const uint8_t> _records; ///< The validated records.
+    const uint8_t* _last = nullptr;    ///< Start of the last record.
+    size_t _count = 0;                 ///< Number of records.
+    uint8_t _version = 1;              ///< Version of the response, which sets the record layout.
+};
\ No newline at end of file
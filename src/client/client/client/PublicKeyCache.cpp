@@ -0,0 +1,131 @@
+﻿#include "PublicKeyCache.h"
+#include "MappedFile.h"
+#include "ByteWriter.h"
+
+
+static const char CACHE_MAGIC[4] = { 'M', 'U', 'K', '1' };
+static const size_t CACHE_HEADER_SIZE = 4 + 4; // magic, key count
+static const size_t CLIENT_ID_SIZE = ClientId::SIZE;
+
+std::shared_ptr<const PeerKey> PeerKey::parse(std::string_view keyBytes) {
+    auto key = std::make_shared<PeerKey>();
+    if (keyBytes.size() == X25519Wrapper::KEYSIZE) {
+        key->agreementKey = std::string(keyBytes);
+    }
+    else {
+        key->rsa = std::make_shared<RSAPublicWrapper>(keyBytes.data(), static_cast<unsigned int>(keyBytes.size()));
+    }
+    return key;
+}
+
+PublicKeyCache::PublicKeyCache(size_t capacity) : _capacity(std::max<size_t>(capacity, 1)) {
+}
+
+std::shared_ptr<const PeerKey> PublicKeyCache::find(const ClientId& clientId) {
+    auto it = _index.find(clientId);
+    if (it == _index.end()) {
+        return nullptr;
+    }
+    _entries.splice(_entries.begin(), _entries, it->second);
+    Entry& entry = *it->second;
+    if (!entry.key) {
+        try {
+            entry.key = PeerKey::parse(entry.keyBytes);
+        }
+        catch (const CryptoPP::Exception&) {
+            // A damaged key from the cache file is dropped, so it is fetched again.
+            erase(clientId);
+            return nullptr;
+        }
+    }
+    return entry.key;
+}
+
+std::shared_ptr<const PeerKey> PublicKeyCache::insert(const ClientId& clientId, std::string_view keyBytes) {
+    auto it = _index.find(clientId);
+    if (it != _index.end() && it->second->keyBytes == keyBytes) {
+        return find(clientId);
+    }
+    // Parse first, so a malformed key leaves the cache unchanged.
+    auto key = PeerKey::parse(keyBytes);
+    if (it != _index.end()) {
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+    _entries.push_front(Entry{ clientId, std::string(keyBytes), key });
+    _index[clientId] = _entries.begin();
+    evictOverCapacity();
+    return key;
+}
+
+void PublicKeyCache::erase(const ClientId& clientId) {
+    auto it = _index.find(clientId);
+    if (it != _index.end()) {
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+}
+
+void PublicKeyCache::clear() {
+    _entries.clear();
+    _index.clear();
+}
+
+bool PublicKeyCache::load(const std::string& path) {
+    clear();
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+    try {
+        MappedFile file(path);
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+        if (file.size() < CACHE_HEADER_SIZE || std::memcmp(data, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+            return false;
+        }
+        size_t count = readUint32(data + 4);
+        size_t offset = CACHE_HEADER_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            if (file.size() - offset < CLIENT_ID_SIZE + 2) {
+                clear();
+                return false;
+            }
+            size_t keyLength = readUint16(data + offset + CLIENT_ID_SIZE);
+            if (file.size() - offset - CLIENT_ID_SIZE - 2 < keyLength) {
+                clear();
+                return false;
+            }
+            ClientId clientId(file.data() + offset);
+            // The file lists the most recently used key first.
+            if (_index.find(clientId) == _index.end()) {
+                _entries.push_back(Entry{ clientId, std::string(file.data() + offset + CLIENT_ID_SIZE + 2, keyLength), nullptr });
+                _index[clientId] = std::prev(_entries.end());
+            }
+            offset += CLIENT_ID_SIZE + 2 + keyLength;
+        }
+        evictOverCapacity();
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        clear();
+        return false;
+    }
+}
+
+void PublicKeyCache::save(const std::string& path) const {
+    ByteWriter contents;
+    contents.putBytes(CACHE_MAGIC, sizeof(CACHE_MAGIC)).putUint32(static_cast<uint32_t>(_entries.size()));
+    for (const Entry& entry : _entries) {
+        contents.putBytes(entry.clientId.view()).putUint16(static_cast<uint16_t>(entry.keyBytes.size())).putBytes(entry.keyBytes);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(contents.data()), contents.size())) {
+        throw std::runtime_error("Unable to write public key cache: " + path);
+    }
+}
+
+void PublicKeyCache::evictOverCapacity() {
+    while (_entries.size() > _capacity) {
+        _index.erase(_entries.back().clientId);
+        _entries.pop_back();
+    }
+}
\ No newline at end of file
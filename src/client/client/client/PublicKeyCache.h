@@ -0,0 +1,113 @@
+﻿#pragma once
+#include "utils.h"
+#include "ClientId.h"
+#include "RSAWrapper.h"
+#include "X25519Wrapper.h"
+#include <list>
+
+
+/**
+ * @brief A peer's public key: an RSA key that session keys are sent under, or an X25519 key that
+ *        session keys are agreed with.
+ */
+struct PeerKey {
+    std::shared_ptr<RSAPublicWrapper> rsa; ///< The parsed RSA key; null for an X25519 key.
+    std::string agreementKey;              ///< The raw 32-byte X25519 key; empty for an RSA key.
+
+    /**
+     * @brief Parses a key as the server returns it; a 32-byte key is an X25519 key, anything else DER.
+     *
+     * @throws CryptoPP::Exception if an RSA key cannot be parsed.
+     */
+    static std::shared_ptr<const PeerKey> parse(std::string_view keyBytes);
+
+    bool isAgreementKey() const { return !rsa; }
+
+    /**
+     * @brief Returns the key in binary form, as the server stores it.
+     */
+    std::string bytes() const { return rsa ? rsa->getPublicKey() : agreementKey; }
+};
+
+/**
+ * @brief Bounded cache of the peers' public keys, by raw 16-byte client ID.
+ *
+ * Each key is kept in binary form together with its parsed PeerKey, so a key exchange with a
+ * known peer needs neither a 602 round trip nor another DER parse. The least recently used key is
+ * dropped once the cache holds \p capacity keys.
+ *
+ * The cache can be saved to and loaded from a file: [4 bytes magic][4 bytes key count], then per
+ * key [16 bytes client ID][2 bytes key length][key], most recently used first. Loaded keys are
+ * parsed on first use.
+ */
+class PublicKeyCache {
+public:
+    static const size_t DEFAULT_CAPACITY = 256;
+
+    explicit PublicKeyCache(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Returns the parsed key of a client and marks it as recently used.
+     *
+     * @param clientId The client ID.
+     * @return The key, or null if the client's key is not cached (or was loaded from the cache
+     *         file but cannot be parsed).
+     */
+    std::shared_ptr<const PeerKey> find(const ClientId& clientId);
+
+    /**
+     * @brief Adds or replaces the key of a client.
+     *
+     * If the client already has the same key, the existing parsed object is returned; a different
+     * key (the server reports a key change) replaces it.
+     *
+     * @param clientId The client ID.
+     * @param keyBytes The public key in binary form (RSA DER or raw X25519).
+     * @return The parsed key.
+     *
+     * @throws CryptoPP::Exception if the key cannot be parsed.
+     */
+    std::shared_ptr<const PeerKey> insert(const ClientId& clientId, std::string_view keyBytes);
+
+    /**
+     * @brief Drops the key of a client, e.g. because it is no longer valid.
+     */
+    void erase(const ClientId& clientId);
+
+    /**
+     * @brief Drops all keys.
+     */
+    void clear();
+
+    size_t size() const { return _entries.size(); }
+
+    /**
+     * @brief Replaces the cached keys with the keys saved in a file.
+     *
+     * @param path The path of the cache file.
+     * @return true if the file was loaded; a missing or malformed file leaves the cache empty.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief Saves the cached keys to a file.
+     *
+     * @param path The path of the cache file.
+     *
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string& path) const;
+
+private:
+    struct Entry {
+        ClientId clientId;                   ///< Client ID.
+        std::string keyBytes;                ///< The key in binary form.
+        std::shared_ptr<const PeerKey> key;  ///< The parsed key; null until first used after a load.
+    };
+
+    void evictOverCapacity();
+
+    size_t _capacity;                                                ///< Maximum number of keys.
+    std::list<Entry> _entries;                                       ///< Keys, most recently used first.
+    std::unordered_map<ClientId, std::list<Entry>::iterator> _index; ///< Entries by client ID.
+};
\ No newline at end of file
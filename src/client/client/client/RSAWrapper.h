@@ -1,6 +1,5 @@
 #pragma once
 
-#include <osrng.h>
 #include <rsa.h>
 
 #include <string>
@@ -14,8 +13,7 @@ public:
 	static const unsigned int BITS = 1024;
 
 private:
-	CryptoPP::AutoSeededRandomPool _rng;
-	CryptoPP::RSA::PublicKey _publicKey;
+	CryptoPP::RSAES_OAEP_SHA_Encryptor _encryptor;	// holds the key; set up once, used for every encryption
 
 	RSAPublicWrapper(const RSAPublicWrapper& rsapublic);
 	RSAPublicWrapper& operator=(const RSAPublicWrapper& rsapublic);
@@ -33,14 +31,14 @@ public:
 };
 
 
+// decrypt may be called from several threads at once on the same key.
 class RSAPrivateWrapper
 {
 public:
 	static const unsigned int BITS = 1024;
 
 private:
-	CryptoPP::AutoSeededRandomPool _rng;
-	CryptoPP::RSA::PrivateKey _privateKey;
+	CryptoPP::RSAES_OAEP_SHA_Decryptor _decryptor;	// holds the key; set up once, used for every decryption
 
 	RSAPrivateWrapper(const RSAPrivateWrapper& rsaprivate);
 	RSAPrivateWrapper& operator=(const RSAPrivateWrapper& rsaprivate);
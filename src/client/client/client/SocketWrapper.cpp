@@ -1,29 +1,142 @@
 ﻿#include "SocketWrapper.h"
 #include "utils.h"
+#include "protocol.h"
 
 
-// Constructor: creates a TCP socket and connects to the server at the specified IP and port.
-SocketWrapper::SocketWrapper(const std::string& serverIp, unsigned short serverPort) : sock(INVALID_SOCKET) {
+// Checks whether a socket error code means that the operation would block.
+static bool isWouldBlock(int error) {
+#ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+#else
+    return error == EAGAIN || error == EWOULDBLOCK;
+#endif
+}
+
+// Checks whether a socket error code means that a non-blocking connect is still in progress.
+static bool isConnectInProgress(int error) {
+#ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+#else
+    return error == EINPROGRESS;
+#endif
+}
+
+// Checks whether a socket call was interrupted by a signal and should simply be repeated.
+static bool isInterrupted(int error) {
+#ifdef _WIN32
+    return false;
+#else
+    return error == EINTR;
+#endif
+}
+
+// Checks whether a socket error code means that the peer reset the connection.
+static bool isConnectionReset(int error) {
+#ifdef _WIN32
+    return error == WSAECONNRESET || error == WSAECONNABORTED;
+#else
+    return error == ECONNRESET;
+#endif
+}
+
+// Switches the socket to non-blocking mode.
+static bool setNonBlocking(SOCKET sock) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// Copies the non-empty buffers into an array that can be advanced while sending.
+static size_t collectBuffers(const ConstBuffer* buffers, size_t count, ConstBuffer* out) {
+    if (count > SocketWrapper::MAX_SEND_BUFFERS) {
+        throw std::length_error("Too many buffers for a single send: " + std::to_string(count));
+    }
+    size_t pending = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (buffers[i].size != 0) {
+            out[pending++] = buffers[i];
+        }
+    }
+    return pending;
+}
+
+// Skips the buffers that went out completely and trims the one that was sent partially.
+static void advanceBuffers(ConstBuffer*& next, size_t& pending, size_t sent) {
+    while (pending > 0 && sent >= next->size) {
+        sent -= next->size;
+        next++;
+        pending--;
+    }
+    if (pending > 0) {
+        next->data += sent;
+        next->size -= sent;
+    }
+}
+
+// Extracts the little-endian payload size from a response header.
+static uint32_t framePayloadSize(const uint8_t* header) {
+    return Wire::ResponseHeader::PayloadSize::get(header);
+}
+
+// Rejects frames that declare a larger payload than the caller accepts.
+static void checkFrameSize(uint32_t payloadSize, size_t maxFrameSize) {
+    if (payloadSize > maxFrameSize) {
+        throw std::length_error("Response payload of " + std::to_string(payloadSize) +
+            " bytes exceeds the maximum frame size of " + std::to_string(maxFrameSize) + " bytes");
+    }
+}
+
+
+void SocketWrapper::initializeNetwork() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        throw std::runtime_error("Failed to initialize Winsock!");
+    }
+#endif
+}
+
+void SocketWrapper::cleanupNetwork() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Constructor: creates a non-blocking TCP socket and starts connecting to the server at the specified IP and port.
+SocketWrapper::SocketWrapper(const std::string& serverIp, unsigned short serverPort)
+    : sock(INVALID_SOCKET), connectPending(false), serverAddress(serverIp + ":" + std::to_string(serverPort)) {
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         throw std::runtime_error("Failed to create socket!");
     }
 
     // Set up the server address structure.
-    sockaddr_in serverAddr;
+    sockaddr_in serverAddr = {};
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_port = htons(serverPort);
 
     // Convert the server IP from string to binary form.
     if (inet_pton(AF_INET, serverIp.c_str(), &serverAddr.sin_addr) <= 0) {
-        closesocket(sock);
+        closeSocket();
         throw std::runtime_error("Invalid server IP address: " + serverIp);
     }
 
-    // Connect to the server.
+    if (!setNonBlocking(sock)) {
+        closeSocket();
+        throw std::runtime_error("Failed to switch socket to non-blocking mode");
+    }
+
+    // Start the connect; its outcome is reported through SO_ERROR once the socket is writable.
     if (connect(sock, reinterpret_cast<struct sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
-        closesocket(sock);
-        throw std::runtime_error("Failed to connect to server " + serverIp + ":" + std::to_string(serverPort));
+        if (!isConnectInProgress(lastSocketError())) {
+            closeSocket();
+            throw std::runtime_error("Failed to connect to server " + serverAddress);
+        }
+        connectPending = true;
     }
 }
 
@@ -38,50 +151,142 @@ bool SocketWrapper::isValid() const {
     return sock != INVALID_SOCKET;
 }
 
-// Sends all data from the provided vector, ensuring the entire payload is transmitted.
-bool SocketWrapper::sendAll(const std::vector<uint8_t>& data) const{
-    int totalSent = 0;
-    int dataSize = static_cast<int>(data.size());
+bool SocketWrapper::isConnecting() const {
+    return connectPending;
+}
 
-    // Loop until all bytes are sent.
-    while (totalSent < dataSize) {
-        int sent = send(sock, reinterpret_cast<const char*>(data.data() + totalSent), dataSize - totalSent, 0);
-        if (sent == SOCKET_ERROR) {
-            throw std::runtime_error("Failed to send data: " + std::to_string(WSAGetLastError()));
-        }
-        totalSent += sent;
+SOCKET SocketWrapper::nativeHandle() const {
+    return sock;
+}
+
+void SocketWrapper::setNoDelay(bool enabled) {
+    int flag = enabled ? 1 : 0;
+    if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&flag), sizeof(flag)) == SOCKET_ERROR) {
+        throw std::runtime_error("Failed to set TCP_NODELAY: " + std::to_string(lastSocketError()));
     }
-    return true;
 }
 
-// Receives data from the socket in chunks and returns the complete response.
-std::vector<uint8_t> SocketWrapper::receiveAll() const {
-    std::vector<uint8_t> response;
+// An idle connection must have nothing to read: readability means EOF, a reset or stray data.
+bool SocketWrapper::isAlive() const {
     if (sock == INVALID_SOCKET) {
-        throw std::runtime_error("Socket is invalid!");
+        return false;
     }
+    SocketPollFd fd = {};
+    fd.fd = sock;
+    fd.events = POLLIN;
+    return pollSockets(&fd, 1, 0) == 0;
+}
 
-    const size_t CHUNK_SIZE = 1024;
-    char buffer[CHUNK_SIZE];
-
-    // Read data until the server closes the connection.
-    while (true) {
-        int bytesRead = recv(sock, buffer, CHUNK_SIZE, 0);
-        if (bytesRead == 0) {
-            // The server closed the connection gracefully.
-            break;
+void SocketWrapper::connectAsync(EventLoop& loop, SendHandler done) {
+    SOCKET handle = sock;
+    loop.watch(handle, EventLoop::WRITABLE, [this, &loop, handle, done](uint32_t) {
+        loop.unwatch(handle);
+        try {
+            finishConnect();
         }
-        if (bytesRead < 0) {
-            throw std::runtime_error("Error in recv: " + std::to_string(WSAGetLastError()));
+        catch (...) {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    });
+}
+
+void SocketWrapper::sendBuffersAsync(EventLoop& loop, const ConstBuffer* buffers, size_t count, SendHandler done) {
+    struct SendState {
+        ConstBuffer remaining[MAX_SEND_BUFFERS];
+        ConstBuffer* next;
+        size_t pending;
+        SendHandler done;
+    };
+    auto state = std::make_shared<SendState>();
+    state->pending = collectBuffers(buffers, count, state->remaining);
+    state->next = state->remaining;
+    state->done = std::move(done);
+
+    SOCKET handle = sock;
+    loop.watch(handle, EventLoop::WRITABLE, [this, &loop, state, handle](uint32_t) {
+        try {
+            while (state->pending > 0) {
+                size_t sent = sendSome(state->next, state->pending);
+                if (sent == 0) {
+                    return; // Continue on the next writability event.
+                }
+                advanceBuffers(state->next, state->pending, sent);
+            }
         }
-        if (bytesRead > CHUNK_SIZE) {
-            throw std::runtime_error("recv returned too large value");
+        catch (...) {
+            loop.unwatch(handle);
+            state->done(std::current_exception());
+            return;
         }
+        loop.unwatch(handle);
+        state->done(nullptr);
+    });
+}
 
-        response.insert(response.end(), buffer, buffer + bytesRead);
-    }
+void SocketWrapper::receiveFrameAsync(EventLoop& loop, size_t maxFrameSize, ReceiveHandler done) {
+    struct ReceiveState {
+        uint8_t header[Protocol::RESPONSE_HEADER_SIZE];
+        size_t headerRead = 0;
+        std::vector<uint8_t> frame; ///< Allocated once the header is complete.
+        size_t frameRead = 0;
+        size_t maxFrameSize = 0;
+        ReceiveHandler done;
+    };
+    auto state = std::make_shared<ReceiveState>();
+    state->maxFrameSize = maxFrameSize;
+    state->done = std::move(done);
 
-    return response;
+    SOCKET handle = sock;
+    loop.watch(handle, EventLoop::READABLE, [this, &loop, state, handle](uint32_t) {
+        try {
+            // Read everything that is available; stop when the socket would block.
+            while (true) {
+                size_t received = 0;
+                if (state->frame.empty()) {
+                    if (!receiveSome(state->header + state->headerRead, sizeof(state->header) - state->headerRead, received)) {
+                        return;
+                    }
+                    if (received == 0) {
+                        if (state->headerRead != 0) {
+                            throw std::runtime_error("Connection closed in the middle of a response header");
+                        }
+                        loop.unwatch(handle);
+                        state->done({}, nullptr);
+                        return;
+                    }
+                    state->headerRead += received;
+                    if (state->headerRead < sizeof(state->header)) {
+                        continue;
+                    }
+                    uint32_t payloadSize = framePayloadSize(state->header);
+                    checkFrameSize(payloadSize, state->maxFrameSize);
+                    state->frame.resize(sizeof(state->header) + payloadSize);
+                    std::memcpy(state->frame.data(), state->header, sizeof(state->header));
+                    state->frameRead = sizeof(state->header);
+                }
+                else {
+                    if (!receiveSome(state->frame.data() + state->frameRead, state->frame.size() - state->frameRead, received)) {
+                        return;
+                    }
+                    if (received == 0) {
+                        throw std::runtime_error("Connection closed in the middle of a response payload");
+                    }
+                    state->frameRead += received;
+                }
+                if (state->frameRead == state->frame.size()) {
+                    loop.unwatch(handle);
+                    state->done(std::move(state->frame), nullptr);
+                    return;
+                }
+            }
+        }
+        catch (...) {
+            loop.unwatch(handle);
+            state->done({}, std::current_exception());
+        }
+    });
 }
 
 // Closes the socket and marks it as invalid.
@@ -90,4 +295,83 @@ void SocketWrapper::closeSocket() {
         closesocket(sock);
         sock = INVALID_SOCKET;
     }
+}
+
+size_t SocketWrapper::sendSome(const ConstBuffer* buffers, size_t count) const {
+#ifdef _WIN32
+    WSABUF wsaBuffers[MAX_SEND_BUFFERS];
+    for (size_t i = 0; i < count; i++) {
+        wsaBuffers[i].buf = const_cast<CHAR*>(reinterpret_cast<const CHAR*>(buffers[i].data));
+        wsaBuffers[i].len = static_cast<ULONG>(buffers[i].size);
+    }
+    DWORD sent = 0;
+    if (WSASend(sock, wsaBuffers, static_cast<DWORD>(count), &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+        int error = lastSocketError();
+        if (isWouldBlock(error)) {
+            return 0;
+        }
+        throw std::runtime_error("Failed to send data: " + std::to_string(error));
+    }
+    return sent;
+#else
+    iovec vectors[MAX_SEND_BUFFERS];
+    for (size_t i = 0; i < count; i++) {
+        vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].data);
+        vectors[i].iov_len = buffers[i].size;
+    }
+    msghdr message = {};
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+    while (true) {
+        // MSG_NOSIGNAL: a closed peer must surface as an error, not as SIGPIPE.
+        ssize_t sent = sendmsg(sock, &message, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            return static_cast<size_t>(sent);
+        }
+        int error = lastSocketError();
+        if (isWouldBlock(error)) {
+            return 0;
+        }
+        if (!isInterrupted(error)) {
+            throw std::runtime_error("Failed to send data: " + std::to_string(error));
+        }
+    }
+#endif
+}
+
+bool SocketWrapper::receiveSome(uint8_t* buffer, size_t length, size_t& received) const {
+    int chunk = static_cast<int>(std::min(length, static_cast<size_t>(std::numeric_limits<int>::max())));
+    while (true) {
+        int bytesRead = static_cast<int>(recv(sock, reinterpret_cast<char*>(buffer), chunk, 0));
+        if (bytesRead >= 0) {
+            received = static_cast<size_t>(bytesRead);
+            return true;
+        }
+        int error = lastSocketError();
+        if (isWouldBlock(error)) {
+            return false;
+        }
+        if (isConnectionReset(error)) {
+            // A reset (e.g. after writing to a connection the server had already closed) ends the
+            // stream like a close does; a frame cut short by it is still an error.
+            received = 0;
+            return true;
+        }
+        if (!isInterrupted(error)) {
+            throw std::runtime_error("Error in recv: " + std::to_string(error));
+        }
+    }
+}
+
+void SocketWrapper::finishConnect() {
+    int connectError = 0;
+    socklen_t length = sizeof(connectError);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&connectError), &length) == SOCKET_ERROR) {
+        connectError = lastSocketError();
+    }
+    connectPending = false;
+    if (connectError != 0) {
+        closeSocket();
+        throw std::runtime_error("Failed to connect to server " + serverAddress);
+    }
 }
\ No newline at end of file
@@ -1,23 +1,75 @@
 ﻿#pragma once
 #include "utils.h"
+#include "EventLoop.h"
+#include <exception>
 
 
+/**
+ * @brief A non-owning view of a block of bytes to be sent.
+ *
+ * Used to describe the parts of a message that live in different places (request header,
+ * message sub-header, ciphertext) so they can be sent without being copied into one buffer.
+ */
+struct ConstBuffer {
+    const uint8_t* data; ///< Start of the bytes to send.
+    size_t size;         ///< Number of bytes to send.
+};
+
 /**
  * @brief A wrapper class for TCP socket operations.
  *
- * This class encapsulates a WinSock TCP socket, providing functionality to create the socket,
- * connect to a server using an IP address and port, send and receive data reliably, and close the socket.
+ * This class encapsulates a TCP socket (WinSock on Windows, BSD sockets on POSIX), providing
+ * functionality to create the socket, connect to a server using an IP address and port, send and
+ * receive data reliably, and close the socket.
+ *
+ * The socket is always in non-blocking mode. Connecting, sending and receiving are completed by
+ * the asynchronous methods (connectAsync, sendBuffersAsync, receiveFrameAsync), which register the
+ * socket with an EventLoop, so one thread can keep many requests in flight.
  */
 class SocketWrapper {
 public:
+    static const size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024; ///< Default limit for a received payload (64 MiB).
+    static const size_t MAX_SEND_BUFFERS = 8; ///< Maximum number of buffers in one sendBuffersAsync call.
+
+    /**
+     * @brief Completion handler of sendBuffersAsync; \p error is null on success.
+     */
+    using SendHandler = std::function<void(std::exception_ptr error)>;
+
+    /**
+     * @brief Completion handler of receiveFrameAsync.
+     *
+     * On success \p error is null and \p frame holds the header and payload (empty if the peer
+     * closed the connection before sending anything).
+     */
+    using ReceiveHandler = std::function<void(std::vector<uint8_t> frame, std::exception_ptr error)>;
+
+    /**
+     * @brief Initializes the socket library of the platform.
+     *
+     * Calls WSAStartup on Windows and does nothing on POSIX systems. Must be called once before
+     * any socket is created.
+     *
+     * @throws std::runtime_error if the socket library cannot be initialized.
+     */
+    static void initializeNetwork();
+
+    /**
+     * @brief Releases the socket library of the platform (WSACleanup on Windows).
+     */
+    static void cleanupNetwork();
+
     /**
-     * @brief Constructs a new SocketWrapper and connects to the specified server.
+     * @brief Constructs a new SocketWrapper and starts connecting to the specified server.
      *
-     * This constructor creates a TCP socket and attempts to connect it to the server identified
-     * by the provided IP address and port.
+     * This constructor creates a non-blocking TCP socket and starts connecting it to the server
+     * identified by the provided IP address and port. The connect may still be in progress on
+     * return and must be completed with connectAsync before the socket is used.
      *
      * @param serverIp The IP address of the server.
      * @param serverPort The port number of the server.
+     *
+     * @throws std::runtime_error if the socket cannot be created or the connect cannot be started.
      */
     SocketWrapper(const std::string& serverIp, unsigned short serverPort);
 
@@ -28,6 +80,9 @@ public:
      */
     ~SocketWrapper();
 
+    SocketWrapper(const SocketWrapper&) = delete;
+    SocketWrapper& operator=(const SocketWrapper&) = delete;
+
     /**
      * @brief Checks if the socket is valid.
      *
@@ -38,25 +93,76 @@ public:
     bool isValid() const;
 
     /**
-     * @brief Sends all data over the socket.
+     * @brief Checks whether the connect started by the constructor has not been completed yet.
+     */
+    bool isConnecting() const;
+
+    /**
+     * @brief Returns the underlying socket handle, e.g. for registering it with an EventLoop.
+     */
+    SOCKET nativeHandle() const;
+
+    /**
+     * @brief Enables or disables the TCP_NODELAY option (Nagle's algorithm).
+     *
+     * @param enabled true to send small writes immediately, false to let TCP coalesce them.
+     *
+     * @throws std::runtime_error if the option cannot be set.
+     */
+    void setNoDelay(bool enabled);
+
+    /**
+     * @brief Checks whether an idle connection is still open.
+     *
+     * Polls the socket without blocking. A connection that the peer has closed or reset, or that
+     * has unexpected unread data pending, is reported as not alive.
+     *
+     * @return true if the connection can be used for a new request, false otherwise.
+     */
+    bool isAlive() const;
+
+    /**
+     * @brief Completes the connect started by the constructor, without blocking the calling thread.
+     *
+     * The socket is registered with \p loop for writability; \p done is called from the loop
+     * with null once the connection is established, or with the error that made it fail.
+     * This SocketWrapper must stay alive until \p done is called.
+     *
+     * @param loop The event loop that drives the operation.
+     * @param done The completion handler.
+     */
+    void connectAsync(EventLoop& loop, SendHandler done);
+
+    /**
+     * @brief Starts sending several buffers without blocking the calling thread.
      *
-     * This method ensures that the entire data vector is sent over the socket, even if multiple
-     * send operations are required.
+     * The socket is registered with \p loop for writability and the data is sent as the socket
+     * accepts it. The buffers are handed to the socket layer together (WSASend on Windows, sendmsg
+     * with an iovec array on POSIX), so the caller never has to concatenate them. \p done is
+     * called from the loop once everything is sent or sending failed. The buffers (not the array
+     * describing them) and this SocketWrapper must stay alive until \p done is called. A socket
+     * can have only one asynchronous operation at a time.
      *
-     * @param data A vector of bytes representing the data to send.
-     * @return true if all data was sent successfully, false otherwise.
+     * @param loop The event loop that drives the operation.
+     * @param buffers The buffers to send, in order.
+     * @param count The number of buffers (at most MAX_SEND_BUFFERS).
+     * @param done The completion handler.
      */
-    bool sendAll(const std::vector<uint8_t>& data) const;
+    void sendBuffersAsync(EventLoop& loop, const ConstBuffer* buffers, size_t count, SendHandler done);
 
     /**
-     * @brief Receives data from the socket.
+     * @brief Starts receiving one protocol frame without blocking the calling thread.
      *
-     * This method receives data from the socket using a default buffer size of 1024 bytes and
-     * returns the data in a vector. If the connection is closed gracefully, an empty vector is returned.
+     * The socket is registered with \p loop for readability; the header and then exactly the
+     * declared payload are read as data arrives. \p done is called from the loop with the frame
+     * (the response header followed by the payload, as Protocol::parseResponse expects) or with
+     * the error that ended the operation. This SocketWrapper must stay alive until \p done is called.
      *
-     * @return A vector of bytes containing the received data.
+     * @param loop The event loop that drives the operation.
+     * @param maxFrameSize The largest payload size that will be accepted, in bytes.
+     * @param done The completion handler.
      */
-    std::vector<uint8_t> receiveAll() const;
+    void receiveFrameAsync(EventLoop& loop, size_t maxFrameSize, ReceiveHandler done);
 
     /**
      * @brief Closes the socket.
@@ -66,5 +172,31 @@ public:
     void closeSocket();
 
 private:
-    SOCKET sock; ///< The underlying WinSock socket.
+    /**
+     * @brief Sends as much of the buffers as the socket accepts right now (one system call).
+     *
+     * @return The number of bytes sent; 0 if the socket would block.
+     * @throws std::runtime_error if sending fails.
+     */
+    size_t sendSome(const ConstBuffer* buffers, size_t count) const;
+
+    /**
+     * @brief Receives whatever is available right now, up to \p length bytes (one system call).
+     *
+     * @param received Set to the number of bytes read; 0 means the peer closed (or reset) the connection.
+     * @return false if the socket would block, true otherwise.
+     * @throws std::runtime_error if receiving fails.
+     */
+    bool receiveSome(uint8_t* buffer, size_t length, size_t& received) const;
+
+    /**
+     * @brief Reads the outcome of a completed non-blocking connect and closes the socket if it failed.
+     *
+     * @throws std::runtime_error if the connection could not be established.
+     */
+    void finishConnect();
+
+    SOCKET sock;               ///< The underlying socket.
+    bool connectPending;       ///< A non-blocking connect was started but not completed yet.
+    std::string serverAddress; ///< "ip:port" of the server, for error messages.
 };
\ No newline at end of file
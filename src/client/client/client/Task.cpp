@@ -0,0 +1,60 @@
+﻿#include "Task.h"
+
+
+// Bookkeeping shared by whenAll and the tasks it runs; it lives in the whenAll coroutine frame.
+struct WhenAllState {
+    size_t remaining;                 ///< Tasks that have not finished yet.
+    std::coroutine_handle<> waiting;  ///< The suspended whenAll coroutine.
+    std::exception_ptr firstError;    ///< First exception thrown by one of the tasks.
+};
+
+// Runs one task of a whenAll and wakes the waiting coroutine after the last one finishes.
+// The wake-up is posted rather than resumed here, because resuming whenAll destroys this frame.
+static Task<void> runMember(EventLoop& loop, Task<void> task, WhenAllState& state) {
+    try {
+        co_await task;
+    }
+    catch (...) {
+        if (!state.firstError) {
+            state.firstError = std::current_exception();
+        }
+    }
+    if (--state.remaining == 0) {
+        std::coroutine_handle<> waiting = state.waiting;
+        loop.post([waiting]() { waiting.resume(); });
+    }
+}
+
+// Starts every member when whenAll suspends; the last member to finish resumes it.
+class WhenAllAwaiter {
+public:
+    WhenAllAwaiter(WhenAllState& state, std::vector<Task<void>>& members) : _state(state), _members(members) {}
+
+    bool await_ready() const noexcept { return _members.empty(); }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        _state.waiting = awaiting;
+        for (Task<void>& member : _members) {
+            member.start();
+        }
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    WhenAllState& _state;
+    std::vector<Task<void>>& _members;
+};
+
+Task<void> whenAll(EventLoop& loop, std::vector<Task<void>> tasks) {
+    WhenAllState state{ tasks.size(), nullptr, nullptr };
+    std::vector<Task<void>> members;
+    members.reserve(tasks.size());
+    for (Task<void>& task : tasks) {
+        members.push_back(runMember(loop, std::move(task), state));
+    }
+    co_await WhenAllAwaiter(state, members);
+    if (state.firstError) {
+        std::rethrow_exception(state.firstError);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+﻿#pragma once
+#include "EventLoop.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+
+template <typename T> class Task;
+
+/**
+ * @brief State shared by the promise types of all Task<T> coroutines.
+ *
+ * Tasks start suspended (lazy) and, when they finish, transfer control straight back to the
+ * coroutine that awaited them (symmetric transfer), so long await chains do not grow the stack.
+ */
+class TaskPromiseBase {
+public:
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise()._continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { _exception = std::current_exception(); }
+
+    /**
+     * @brief Sets the coroutine that is resumed when this task finishes.
+     */
+    void setContinuation(std::coroutine_handle<> continuation) noexcept { _continuation = continuation; }
+
+protected:
+    void rethrowIfFailed() const {
+        if (_exception) {
+            std::rethrow_exception(_exception);
+        }
+    }
+
+private:
+    std::coroutine_handle<> _continuation; ///< Awaiting coroutine, or null if nobody awaits the task.
+    std::exception_ptr _exception;         ///< Exception that escaped the coroutine body.
+};
+
+/**
+ * @brief Promise of a Task<T> that produces a value.
+ */
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value) { _value.emplace(std::forward<U>(value)); }
+
+    T result() {
+        rethrowIfFailed();
+        return std::move(*_value);
+    }
+
+private:
+    std::optional<T> _value; ///< The value given to co_return.
+};
+
+/**
+ * @brief Promise of a Task<void>.
+ */
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result() const { rethrowIfFailed(); }
+};
+
+
+/**
+ * @brief A lazily started coroutine that produces a value of type T (or nothing for void).
+ *
+ * A Task does not run until it is awaited with co_await (or started with start, syncWait or
+ * whenAll). A task that was started early can still be awaited later, which lets a coroutine
+ * issue a request and do other work before it needs the answer. Exceptions thrown inside the
+ * coroutine are rethrown to the awaiting coroutine. A Task owns its coroutine frame and can only
+ * be moved.
+ */
+template <typename T>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) {}
+    Task(Task&& other) noexcept
+        : _handle(std::exchange(other._handle, nullptr)), _started(std::exchange(other._started, false)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+            _started = std::exchange(other._started, false);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return _handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        _handle.promise().setContinuation(awaiting);
+        // A started task is already waiting for its own I/O and resumes the awaiting coroutine when it finishes.
+        return _started ? std::noop_coroutine() : std::coroutine_handle<>(_handle);
+    }
+
+    T await_resume() { return _handle.promise().result(); }
+
+    /**
+     * @brief Runs the task until its first suspension point without awaiting it.
+     */
+    void start() {
+        _started = true;
+        _handle.resume();
+    }
+
+    /**
+     * @brief Checks whether the task has finished (with a value or an exception).
+     */
+    bool done() const noexcept { return _handle.done(); }
+
+    /**
+     * @brief Returns the result of a finished task, rethrowing its exception if it failed.
+     */
+    T result() { return _handle.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle; ///< The owned coroutine frame.
+    bool _started = false;                       ///< Whether start() has been called.
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+
+/**
+ * @brief Awaiter that suspends the coroutine and resumes it from the next round of an EventLoop.
+ *
+ * Awaiting it gives the loop a chance to make progress on other pending I/O in the middle of a
+ * long piece of work.
+ */
+class YieldAwaiter {
+public:
+    explicit YieldAwaiter(EventLoop& loop) : _loop(loop) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        _loop.post([awaiting]() { awaiting.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    EventLoop& _loop;
+};
+
+inline YieldAwaiter yieldTo(EventLoop& loop) {
+    return YieldAwaiter(loop);
+}
+
+/**
+ * @brief Runs a task to completion on the calling thread, driving \p loop while it waits.
+ *
+ * This is the bridge from blocking code to the asynchronous API. It must not be called from
+ * inside a task that runs on the same loop.
+ *
+ * @param loop The event loop the task's I/O is registered with.
+ * @param task The task to run.
+ * @return The task's result.
+ *
+ * @throws The exception the task failed with, or std::logic_error if the task waits for
+ *         something that the loop can never deliver.
+ */
+template <typename T>
+T syncWait(EventLoop& loop, Task<T> task) {
+    task.start();
+    while (!task.done()) {
+        if (loop.empty()) {
+            throw std::logic_error("Task is suspended but nothing is pending in the event loop");
+        }
+        loop.runOnce(-1);
+    }
+    return task.result();
+}
+
+/**
+ * @brief Runs several tasks concurrently and completes when all of them have finished.
+ *
+ * All tasks are started at once, so their I/O overlaps on \p loop. If any task fails, the
+ * first exception is rethrown after every task has finished.
+ *
+ * @param loop The event loop used to resume the waiting coroutine.
+ * @param tasks The tasks to run.
+ */
+Task<void> whenAll(EventLoop& loop, std::vector<Task<void>> tasks);
\ No newline at end of file
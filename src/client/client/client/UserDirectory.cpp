@@ -0,0 +1,221 @@
+﻿#include "UserDirectory.h"
+#include "MappedFile.h"
+#include <cctype>
+
+
+static const uint8_t CACHE_MAGIC[4] = { 'M', 'U', 'D', '1' };
+static const size_t CACHE_HEADER_SIZE = 4 + 4 + 4; // magic, generation, user count
+
+
+// The username of a clients list record: up to the first null, without surrounding whitespace.
+static std::string_view recordName(const uint8_t* record) {
+    std::string_view view = Wire::ClientRecord::UserName::get(record);
+    view = view.substr(0, view.find('\0'));
+    while (!view.empty() && std::isspace(static_cast<unsigned char>(view.front()))) {
+        view.remove_prefix(1);
+    }
+    while (!view.empty() && std::isspace(static_cast<unsigned char>(view.back()))) {
+        view.remove_suffix(1);
+    }
+    return view;
+}
+
+void UserDirectory::load(std::span<const uint8_t> payload) {
+    clear();
+    append(payload);
+}
+
+void UserDirectory::append(std::span<const uint8_t> payload) {
+    size_t count = payload.size() / RECORD_SIZE;
+    // Size every buffer up front, so the records below are added without further allocations.
+    size_t namesSize = 0;
+    for (size_t i = 0; i < count; i++) {
+        namesSize += recordName(payload.data() + i * RECORD_SIZE).size();
+    }
+    reserve(count, namesSize);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* record = payload.data() + i * RECORD_SIZE;
+        add(ClientId(record + Wire::ClientRecord::ClientId::offset), recordName(record));
+    }
+}
+
+void UserDirectory::clear() {
+    _entries.clear();
+    _names.clear();
+    _byId.clear();
+    _byName.clear();
+    _generation = 0;
+}
+
+bool UserDirectory::loadCache(const std::string& path) {
+    clear();
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+    try {
+        MappedFile file(path);
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+        if (file.size() < CACHE_HEADER_SIZE || std::memcmp(data, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+            return false;
+        }
+        uint32_t generation = readUint32(data + 4);
+        size_t count = readUint32(data + 8);
+
+        // Validate the records and size the buffers first; then intern the names straight from the mapping.
+        size_t offset = CACHE_HEADER_SIZE;
+        size_t namesSize = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (file.size() - offset < CLIENT_ID_SIZE + 1 || file.size() - offset - CLIENT_ID_SIZE - 1 < data[offset + CLIENT_ID_SIZE]) {
+                return false;
+            }
+            namesSize += data[offset + CLIENT_ID_SIZE];
+            offset += CLIENT_ID_SIZE + 1 + data[offset + CLIENT_ID_SIZE];
+        }
+        reserve(count, namesSize);
+        offset = CACHE_HEADER_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t nameLength = data[offset + CLIENT_ID_SIZE];
+            add(ClientId(data + offset), std::string_view(reinterpret_cast<const char*>(data + offset + CLIENT_ID_SIZE + 1), nameLength));
+            offset += CLIENT_ID_SIZE + 1 + nameLength;
+        }
+        _generation = generation;
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        clear();
+        return false;
+    }
+}
+
+void UserDirectory::saveCache(const std::string& path, size_t firstUnsaved) const {
+    std::fstream file;
+    if (firstUnsaved > 0 && firstUnsaved <= size() && std::filesystem::exists(path)) {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        uint8_t header[CACHE_HEADER_SIZE] = {};
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!file || std::memcmp(header, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || readUint32(header + 8) != firstUnsaved) {
+            file.close(); // Not the file this directory was saved to; write it again.
+        }
+    }
+    if (file.is_open()) {
+        // The saved records are laid out like the name arena, so the end of the first firstUnsaved is known.
+        size_t namesEnd = (firstUnsaved < size()) ? _entries[firstUnsaved].nameOffset : _names.size();
+        file.seekp(CACHE_HEADER_SIZE + firstUnsaved * (CLIENT_ID_SIZE + 1) + namesEnd);
+    }
+    else {
+        firstUnsaved = 0;
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Unable to write directory cache: " + path);
+        }
+        file.write(reinterpret_cast<const char*>(CACHE_MAGIC), sizeof(CACHE_MAGIC));
+        file.write("\0\0\0\0\0\0\0\0", 8); // Generation and count, written last.
+    }
+
+    std::string records;
+    records.reserve((size() - firstUnsaved) * (CLIENT_ID_SIZE + 1) + _names.size());
+    for (size_t i = firstUnsaved; i < size(); i++) {
+        std::string_view name = userName(i);
+        records.append(clientId(i).view());
+        records.push_back(static_cast<char>(name.size()));
+        records.append(name);
+    }
+    file.write(records.data(), records.size());
+
+    // The header is updated after the records, so an interrupted save leaves the old count in place.
+    uint8_t header[8];
+    writeUint32(header, _generation);
+    writeUint32(header + 4, static_cast<uint32_t>(size()));
+    file.seekp(4);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!file) {
+        throw std::runtime_error("Unable to write directory cache: " + path);
+    }
+}
+
+const ClientId* UserDirectory::findClientId(std::string_view userName) const {
+    if (_byName.empty()) {
+        return {};
+    }
+    size_t mask = _byName.size() - 1;
+    for (size_t slot = hashName(userName) & mask; _byName[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t index = _byName[slot] - 1;
+        if (this->userName(index) == userName) {
+            return &_entries[index].clientId;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view UserDirectory::findUserName(const ClientId& clientId) const {
+    if (_byId.empty()) {
+        return {};
+    }
+    size_t mask = _byId.size() - 1;
+    for (size_t slot = clientId.hash() & mask; _byId[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t index = _byId[slot] - 1;
+        if (_entries[index].clientId == clientId) {
+            return userName(index);
+        }
+    }
+    return {};
+}
+
+std::string_view UserDirectory::userName(size_t index) const {
+    const Entry& entry = _entries[index];
+    return std::string_view(_names.data() + entry.nameOffset, entry.nameLength);
+}
+
+// FNV-1a.
+uint64_t UserDirectory::hashName(std::string_view userName) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : userName) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Makes room for count more users; the hash tables are rebuilt when they would become more than half full.
+void UserDirectory::reserve(size_t count, size_t namesSize) {
+    _entries.reserve(_entries.size() + count);
+    _names.reserve(_names.size() + namesSize);
+    size_t capacity = std::max<size_t>(_byId.size(), 16);
+    while (capacity < 2 * (_entries.size() + count)) {
+        capacity *= 2;
+    }
+    if (capacity != _byId.size()) {
+        _byId.assign(capacity, 0);
+        _byName.assign(capacity, 0);
+        for (uint32_t index = 0; index < _entries.size(); index++) {
+            insert(index);
+        }
+    }
+}
+
+// Interns a user; reserve must have made room for it.
+void UserDirectory::add(const ClientId& clientId, std::string_view userName) {
+    Entry entry;
+    entry.clientId = clientId;
+    entry.nameOffset = static_cast<uint32_t>(_names.size());
+    entry.nameLength = static_cast<uint32_t>(userName.size());
+    _names.append(userName);
+    _entries.push_back(entry);
+    insert(static_cast<uint32_t>(_entries.size() - 1));
+}
+
+// Adds an entry to both tables. A duplicate name or ID (which the server does not produce)
+// makes the later entry win, as assigning into a map would.
+void UserDirectory::insert(uint32_t index) {
+    size_t mask = _byId.size() - 1;
+    size_t slot = clientId(index).hash() & mask;
+    while (_byId[slot] != 0 && clientId(_byId[slot] - 1) != clientId(index)) {
+        slot = (slot + 1) & mask;
+    }
+    _byId[slot] = index + 1;
+
+    slot = hashName(userName(index)) & mask;
+    while (_byName[slot] != 0 && userName(_byName[slot] - 1) != userName(index)) {
+        slot = (slot + 1) & mask;
+    }
+    _byName[slot] = index + 1;
+}
\ No newline at end of file
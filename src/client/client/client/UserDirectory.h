@@ -0,0 +1,127 @@
+﻿#pragma once
+#include "ClientId.h"
+#include "WireSchema.h"
+
+
+/**
+ * @brief Directory of the registered users, searchable by username and by client ID.
+ *
+ * The usernames are interned back to back in one character arena, and each direction is an
+ * open-addressing hash table of entry indices: client IDs with ClientId::hash, names with FNV-1a. Looking up a user in either direction is O(1), and loading the 601 clients list
+ * allocates a fixed number of buffers however many records it holds.
+ *
+ * The directory also remembers the server's directory generation it is up to date with, so it can
+ * be extended with only the users added since (request 608), and it can be saved to and loaded from
+ * a compact cache file: [4 bytes magic][4 bytes generation][4 bytes user count], then per user
+ * [16 bytes client ID][1 byte name length][name].
+ *
+ * The views returned by the lookups point into the directory and stay valid until the next
+ * load, append or clear.
+ */
+class UserDirectory {
+public:
+    static const size_t CLIENT_ID_SIZE = Wire::ClientRecord::ClientId::size;
+    static const size_t USERNAME_SIZE = Wire::ClientRecord::UserName::size;
+    static const size_t RECORD_SIZE = Wire::ClientRecord::SIZE; // 271 bytes
+
+    /**
+     * @brief Replaces the directory with the records of a clients list (2101) payload.
+     *
+     * Each record is [16 bytes client ID][255 bytes null-padded username]; surrounding whitespace
+     * is trimmed from the names. A trailing partial record is ignored.
+     *
+     * @param payload The clients list payload.
+     */
+    void load(std::span<const uint8_t> payload);
+
+    /**
+     * @brief Adds the records of a clients list payload to the directory.
+     *
+     * Takes the same records as load, e.g. the users added since the last sync.
+     *
+     * @param payload The clients list records to add.
+     */
+    void append(std::span<const uint8_t> payload);
+
+    /**
+     * @brief Removes all users and resets the generation.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the server directory generation the directory is up to date with (0 if unknown).
+     */
+    uint32_t generation() const { return _generation; }
+
+    void setGeneration(uint32_t generation) { _generation = generation; }
+
+    /**
+     * @brief Replaces the directory with the contents of a cache file.
+     *
+     * The file is memory-mapped and parsed in place. A missing or malformed file leaves the
+     * directory empty.
+     *
+     * @param path The path of the cache file.
+     * @return true if the cache was loaded.
+     */
+    bool loadCache(const std::string& path);
+
+    /**
+     * @brief Saves the directory to a cache file.
+     *
+     * The users from \p firstUnsaved on are appended to the existing file and its header is
+     * rewritten; with \p firstUnsaved set to 0 (or no usable file) the whole file is written.
+     *
+     * @param path The path of the cache file.
+     * @param firstUnsaved Index of the first user the file does not hold yet.
+     *
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void saveCache(const std::string& path, size_t firstUnsaved) const;
+
+    /**
+     * @brief Returns the client ID of a user, or null if the name is unknown.
+     */
+    const ClientId* findClientId(std::string_view userName) const;
+
+    /**
+     * @brief Returns the username of a client ID, or an empty view if the ID is unknown.
+     */
+    std::string_view findUserName(const ClientId& clientId) const;
+
+    /**
+     * @brief Returns the number of users.
+     */
+    size_t size() const { return _entries.size(); }
+
+    bool empty() const { return _entries.empty(); }
+
+    /**
+     * @brief Returns the username of the user at \p index, in clients list order.
+     */
+    std::string_view userName(size_t index) const;
+
+    /**
+     * @brief Returns the client ID of the user at \p index, in clients list order.
+     */
+    const ClientId& clientId(size_t index) const { return _entries[index].clientId; }
+
+private:
+    struct Entry {
+        ClientId clientId;   ///< Client ID.
+        uint32_t nameOffset; ///< Offset of the username in _names.
+        uint32_t nameLength; ///< Length of the username.
+    };
+
+    static uint64_t hashName(std::string_view userName);
+
+    void reserve(size_t count, size_t namesSize);
+    void add(const ClientId& clientId, std::string_view userName);
+    void insert(uint32_t index);
+
+    std::vector<Entry> _entries;   ///< Users in clients list order.
+    std::string _names;            ///< Arena holding all usernames back to back.
+    std::vector<uint32_t> _byId;   ///< Hash table by client ID: entry index + 1, or 0 for a free slot.
+    std::vector<uint32_t> _byName; ///< Hash table by username: entry index + 1, or 0 for a free slot.
+    uint32_t _generation = 0;      ///< Server directory generation the users are up to date with.
+};
\ No newline at end of file
@@ -0,0 +1,315 @@
+﻿#pragma once
+#include "utils.h"
+
+
+/**
+ * @brief Compile-time description of the fixed-size parts of the wire protocol.
+ *
+ * Each layout (a header or a record) is declared once as a chain of fields, each one starting where
+ * the previous one ends, so the offsets and the total SIZE are computed by the compiler. A field
+ * type reads and writes its own bytes with fixed-size memcpy's (little-endian integers, null-padded
+ * byte strings), given a pointer to the start of a record that the caller has bounds-checked once,
+ * e.g. with Wire::record.
+ *
+ * Each layout also lists its fields in FIELDS, with their names; schema_gen turns the lists into
+ * the struct format strings of the server (src/server/communication/schema.py), so the two sides
+ * can't drift apart.
+ */
+namespace Wire {
+
+    /**
+     * @brief A field of \p Size raw bytes at \p Offset; shorter values are null-padded, longer ones truncated.
+     */
+    template <size_t Offset, size_t Size>
+    struct Bytes {
+        static constexpr size_t offset = Offset;
+        static constexpr size_t size = Size;
+        static constexpr size_t end = Offset + Size;
+        static constexpr char code = 's';
+
+        static std::string_view get(const uint8_t* record) {
+            return std::string_view(reinterpret_cast<const char*>(record + Offset), Size);
+        }
+
+        static void put(uint8_t* record, std::string_view value) {
+            size_t copied = std::min(value.size(), Size);
+            std::memcpy(record + Offset, value.data(), copied);
+            std::memset(record + Offset + copied, 0, Size - copied);
+        }
+    };
+
+    /**
+     * @brief A little-endian unsigned integer field of type \p T at \p Offset.
+     */
+    template <typename T, size_t Offset>
+    struct Uint {
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "Only 8-, 16- and 32-bit fields are used");
+        static constexpr size_t offset = Offset;
+        static constexpr size_t size = sizeof(T);
+        static constexpr size_t end = Offset + sizeof(T);
+        static constexpr char code = sizeof(T) == 1 ? 'B' : sizeof(T) == 2 ? 'H' : 'I';
+
+        static T get(const uint8_t* record) {
+            if constexpr (sizeof(T) == 1) {
+                return record[Offset];
+            }
+            else if constexpr (sizeof(T) == 2) {
+                return readUint16(record + Offset);
+            }
+            else {
+                return readUint32(record + Offset);
+            }
+        }
+
+        static void put(uint8_t* record, T value) {
+            if constexpr (sizeof(T) == 1) {
+                record[Offset] = value;
+            }
+            else if constexpr (sizeof(T) == 2) {
+                writeUint16(record + Offset, value);
+            }
+            else {
+                writeUint32(record + Offset, value);
+            }
+        }
+    };
+
+    template <size_t Offset> using Uint8 = Uint<uint8_t, Offset>;
+    template <size_t Offset> using Uint16 = Uint<uint16_t, Offset>;
+    template <size_t Offset> using Uint32 = Uint<uint32_t, Offset>;
+
+    /**
+     * @brief Name and position of one field, as listed in a layout's FIELDS.
+     */
+    struct FieldInfo {
+        const char* name;
+        size_t offset;
+        size_t size;
+        char code; ///< struct format code: 's' (bytes), 'B', 'H' or 'I'.
+    };
+
+    template <typename Field>
+    constexpr FieldInfo field(const char* name) {
+        return FieldInfo{ name, Field::offset, Field::size, Field::code };
+    }
+
+    /**
+     * @brief Checks that a layout's FIELDS follow each other without gaps and cover exactly SIZE bytes.
+     */
+    template <typename Layout>
+    constexpr bool isContiguous() {
+        size_t offset = 0;
+        for (const FieldInfo& info : Layout::FIELDS) {
+            if (info.offset != offset) {
+                return false;
+            }
+            offset += info.size;
+        }
+        return offset == Layout::SIZE;
+    }
+
+    /**
+     * @brief Returns the record of \p Layout at \p offset in \p data, after checking that it fits.
+     *
+     * @throws std::runtime_error if fewer than Layout::SIZE bytes are left at \p offset.
+     */
+    template <typename Layout>
+    const uint8_t* record(std::span<const uint8_t> data, size_t offset = 0) {
+        if (offset > data.size() || data.size() - offset < Layout::SIZE) {
+            throw std::runtime_error(std::string("Truncated ") + Layout::NAME + ". Possibly corrupted data.");
+        }
+        return data.data() + offset;
+    }
+
+    /**
+     * @brief Request header: [16 bytes client ID][1 byte version][2 bytes request code][4 bytes payload size].
+     */
+    struct RequestHeader {
+        using ClientId = Bytes<0, 16>;
+        using Version = Uint8<ClientId::end>;
+        using Code = Uint16<Version::end>;
+        using PayloadSize = Uint32<Code::end>;
+        static constexpr size_t SIZE = PayloadSize::end;
+        static constexpr const char* NAME = "request header";
+        static constexpr FieldInfo FIELDS[] = {
+            field<ClientId>("client_id"), field<Version>("version"), field<Code>("code"), field<PayloadSize>("payload_size") };
+    };
+
+    /**
+     * @brief Response header: [1 byte version][2 bytes response code][4 bytes payload size].
+     */
+    struct ResponseHeader {
+        using Version = Uint8<0>;
+        using Code = Uint16<Version::end>;
+        using PayloadSize = Uint32<Code::end>;
+        static constexpr size_t SIZE = PayloadSize::end;
+        static constexpr const char* NAME = "response header";
+        static constexpr FieldInfo FIELDS[] = {
+            field<Version>("version"), field<Code>("code"), field<PayloadSize>("payload_size") };
+    };
+
+    /**
+     * @brief Registration payload (600) of an X25519 client: [255 bytes username][32 bytes public key].
+     */
+    struct Registration {
+        using UserName = Bytes<0, 255>;
+        using PublicKey = Bytes<UserName::end, 32>;
+        static constexpr size_t SIZE = PublicKey::end;
+        static constexpr const char* NAME = "registration payload";
+        static constexpr FieldInfo FIELDS[] = { field<UserName>("username"), field<PublicKey>("public_key") };
+    };
+
+    /**
+     * @brief Registration payload (600) of an RSA client: [255 bytes username][160 bytes public key].
+     */
+    struct RegistrationRsa {
+        using UserName = Bytes<0, 255>;
+        using PublicKey = Bytes<UserName::end, 160>;
+        static constexpr size_t SIZE = PublicKey::end;
+        static constexpr const char* NAME = "RSA registration payload";
+        static constexpr FieldInfo FIELDS[] = { field<UserName>("username"), field<PublicKey>("public_key") };
+    };
+
+    /**
+     * @brief Sub-header of a sent message (603, 605): [16 bytes to][16 bytes from][1 byte type][4 bytes content size].
+     */
+    struct MessageHeader {
+        using ToClientId = Bytes<0, 16>;
+        using FromClientId = Bytes<ToClientId::end, 16>;
+        using Type = Uint8<FromClientId::end>;
+        using ContentSize = Uint32<Type::end>;
+        static constexpr size_t SIZE = ContentSize::end;
+        static constexpr const char* NAME = "message header";
+        static constexpr FieldInfo FIELDS[] = {
+            field<ToClientId>("to_client_id"), field<FromClientId>("from_client_id"), field<Type>("type"), field<ContentSize>("content_size") };
+    };
+
+    /**
+     * @brief Multicast header (606): [16 bytes from][1 byte type][2 bytes recipient count][4 bytes content size].
+     */
+    struct MulticastHeader {
+        using FromClientId = Bytes<0, 16>;
+        using Type = Uint8<FromClientId::end>;
+        using RecipientCount = Uint16<Type::end>;
+        using ContentSize = Uint32<RecipientCount::end>;
+        static constexpr size_t SIZE = ContentSize::end;
+        static constexpr const char* NAME = "multicast header";
+        static constexpr FieldInfo FIELDS[] = {
+            field<FromClientId>("from_client_id"), field<Type>("type"), field<RecipientCount>("recipient_count"), field<ContentSize>("content_size") };
+    };
+
+    /**
+     * @brief Status record of a 2105/2106 response: [16 bytes to][4 bytes message ID][1 byte status].
+     */
+    struct SendStatus {
+        using ToClientId = Bytes<0, 16>;
+        using MessageId = Uint32<ToClientId::end>;
+        using Status = Uint8<MessageId::end>;
+        static constexpr size_t SIZE = Status::end;
+        static constexpr const char* NAME = "send status";
+        static constexpr FieldInfo FIELDS[] = { field<ToClientId>("to_client_id"), field<MessageId>("message_id"), field<Status>("status") };
+    };
+
+    /**
+     * @brief Fetched message record of protocol version 1: [16 bytes from][4 bytes message ID][1 byte type][4 bytes content size].
+     */
+    struct MessageRecord {
+        using FromClientId = Bytes<0, 16>;
+        using MessageId = Uint32<FromClientId::end>;
+        using Type = Uint8<MessageId::end>;
+        using ContentSize = Uint32<Type::end>;
+        static constexpr size_t SIZE = ContentSize::end;
+        static constexpr const char* NAME = "message record";
+        static constexpr FieldInfo FIELDS[] = {
+            field<FromClientId>("from_client_id"), field<MessageId>("message_id"), field<Type>("type"), field<ContentSize>("content_size") };
+    };
+
+    /**
+     * @brief Fetched message record from protocol version 2 on, with the version the message was sent with.
+     */
+    struct MessageRecordV2 {
+        using FromClientId = Bytes<0, 16>;
+        using MessageId = Uint32<FromClientId::end>;
+        using Type = Uint8<MessageId::end>;
+        using Version = Uint8<Type::end>;
+        using ContentSize = Uint32<Version::end>;
+        static constexpr size_t SIZE = ContentSize::end;
+        static constexpr const char* NAME = "message record";
+        static constexpr FieldInfo FIELDS[] = {
+            field<FromClientId>("from_client_id"), field<MessageId>("message_id"), field<Type>("type"), field<Version>("version"),
+            field<ContentSize>("content_size") };
+    };
+
+    /**
+     * @brief Fetch page request (607): [4 bytes ack ID][4 bytes after ID][4 bytes max count][4 bytes max bytes].
+     */
+    struct FetchPageRequest {
+        using AckMessageId = Uint32<0>;
+        using AfterMessageId = Uint32<AckMessageId::end>;
+        using MaxCount = Uint32<AfterMessageId::end>;
+        using MaxBytes = Uint32<MaxCount::end>;
+        static constexpr size_t SIZE = MaxBytes::end;
+        static constexpr const char* NAME = "fetch page request";
+        static constexpr FieldInfo FIELDS[] = {
+            field<AckMessageId>("ack_message_id"), field<AfterMessageId>("after_message_id"), field<MaxCount>("max_count"), field<MaxBytes>("max_bytes") };
+    };
+
+    /**
+     * @brief Directory sync request (608): [4 bytes known generation].
+     */
+    struct DirectorySyncRequest {
+        using Generation = Uint32<0>;
+        static constexpr size_t SIZE = Generation::end;
+        static constexpr const char* NAME = "directory sync request";
+        static constexpr FieldInfo FIELDS[] = { field<Generation>("generation") };
+    };
+
+    /**
+     * @brief Header of a directory sync response (2108): [4 bytes generation][1 byte full flag], then client list records.
+     */
+    struct DirectorySyncHeader {
+        using Generation = Uint32<0>;
+        using Full = Uint8<Generation::end>;
+        static constexpr size_t SIZE = Full::end;
+        static constexpr const char* NAME = "directory sync header";
+        static constexpr FieldInfo FIELDS[] = { field<Generation>("generation"), field<Full>("full") };
+    };
+
+    /**
+     * @brief Client list record: [16 bytes client ID][255 bytes username, null-padded].
+     */
+    struct ClientRecord {
+        using ClientId = Bytes<0, 16>;
+        using UserName = Bytes<ClientId::end, 255>;
+        static constexpr size_t SIZE = UserName::end;
+        static constexpr const char* NAME = "client record";
+        static constexpr FieldInfo FIELDS[] = { field<ClientId>("client_id"), field<UserName>("username") };
+    };
+
+    /**
+     * @brief Header of a file chunk's content (message type 4): [4 bytes transfer ID][4 bytes chunk index][4 bytes chunk count].
+     */
+    struct FileChunkHeader {
+        using TransferId = Uint32<0>;
+        using Index = Uint32<TransferId::end>;
+        using Count = Uint32<Index::end>;
+        static constexpr size_t SIZE = Count::end;
+        static constexpr const char* NAME = "file chunk header";
+        static constexpr FieldInfo FIELDS[] = { field<TransferId>("transfer_id"), field<Index>("index"), field<Count>("count") };
+    };
+
+    static_assert(isContiguous<RequestHeader>() && RequestHeader::SIZE == 23);
+    static_assert(isContiguous<ResponseHeader>() && ResponseHeader::SIZE == 7);
+    static_assert(isContiguous<Registration>() && Registration::SIZE == 287);
+    static_assert(isContiguous<RegistrationRsa>() && RegistrationRsa::SIZE == 415);
+    static_assert(isContiguous<MessageHeader>() && MessageHeader::SIZE == 37);
+    static_assert(isContiguous<MulticastHeader>() && MulticastHeader::SIZE == 23);
+    static_assert(isContiguous<SendStatus>() && SendStatus::SIZE == 21);
+    static_assert(isContiguous<MessageRecord>() && MessageRecord::SIZE == 25);
+    static_assert(isContiguous<MessageRecordV2>() && MessageRecordV2::SIZE == 26);
+    static_assert(isContiguous<FetchPageRequest>() && FetchPageRequest::SIZE == 16);
+    static_assert(isContiguous<DirectorySyncRequest>() && DirectorySyncRequest::SIZE == 4);
+    static_assert(isContiguous<DirectorySyncHeader>() && DirectorySyncHeader::SIZE == 5);
+    static_assert(isContiguous<ClientRecord>() && ClientRecord::SIZE == 271);
+    static_assert(isContiguous<FileChunkHeader>() && FileChunkHeader::SIZE == 12);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+﻿#include "WorkerPool.h"
+#include <atomic>
+
+
+WorkerPool::WorkerPool(size_t threadCount) {
+    _threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        _threads.emplace_back([this]() { run(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _ready.notify_all();
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void WorkerPool::post(std::function<void()> job) {
+    if (_threads.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _ready.notify_one();
+}
+
+void WorkerPool::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ready.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+            if (_jobs.empty()) {
+                return;
+            }
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    // The state is shared with the helper jobs, which may only get to run after this call has
+    // returned; a late helper finds no index left and never touches body.
+    struct State {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<bool> failed{ false };
+        size_t count = 0;
+        const std::function<void(size_t)>* body = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t done = 0;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->body = &body;
+
+    auto work = [](State& state) {
+        size_t index;
+        while ((index = state.next.fetch_add(1)) < state.count) {
+            // After a failure the remaining indices are only counted, not run.
+            std::exception_ptr error;
+            if (!state.failed) {
+                try {
+                    (*state.body)(index);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                    state.failed = true;
+                }
+            }
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (error && !state.error) {
+                state.error = error;
+            }
+            if (++state.done == state.count) {
+                state.finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(_threads.size(), count > 0 ? count - 1 : 0);
+    for (size_t i = 0; i < helpers; i++) {
+        post([state, work]() { work(*state); });
+    }
+    work(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == state->count; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
\ No newline at end of file
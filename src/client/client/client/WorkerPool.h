@@ -0,0 +1,192 @@
+﻿#pragma once
+#include "utils.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+/**
+ * @brief A fixed set of worker threads for CPU-bound work (encryption, decryption).
+ *
+ * The socket work stays on the client's EventLoop thread; the pool only runs jobs that do not
+ * touch the loop. One process-wide pool (shared) is sized to the machine, so concurrent users
+ * never oversubscribe the cores.
+ *
+ * Example:
+ * @code
+ *   WorkerPool::shared().parallelFor(segments, [&](size_t i) { encryptSegment(i); });
+ * @endcode
+ */
+class WorkerPool {
+public:
+    /**
+     * @brief Starts the given number of worker threads (none is fine: every job then runs on the caller).
+     */
+    explicit WorkerPool(size_t threadCount);
+
+    /**
+     * @brief Runs the jobs that are already queued, then stops and joins the workers.
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Returns the process-wide pool, with one worker less than the hardware threads
+     * (the thread that hands out the work takes part in it).
+     */
+    static WorkerPool& shared();
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    size_t size() const { return _threads.size(); }
+
+    /**
+     * @brief Queues a job to run on one of the workers.
+     *
+     * @param job The job; it must not throw.
+     */
+    void post(std::function<void()> job);
+
+    /**
+     * @brief Runs body(0) .. body(count - 1) on the workers and the calling thread, and returns
+     * once all of them are done.
+     *
+     * The calling thread takes indices too, so the call makes progress even when every worker is
+     * busy. If a call throws, the indices not yet started are skipped and the first exception is
+     * rethrown.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+private:
+    void run();
+
+    std::vector<std::thread> _threads;        ///< The workers.
+    std::deque<std::function<void()>> _jobs;  ///< Jobs not yet started.
+    std::mutex _mutex;                        ///< Guards _jobs and _stopping.
+    std::condition_variable _ready;           ///< Signalled when a job is queued or the pool stops.
+    bool _stopping = false;                   ///< Set by the destructor.
+};
+
+
+/**
+ * @brief Jobs run on a WorkerPool in strands, with their results taken in the order the jobs were added.
+ *
+ * Strands are identified by a hashable Key (e.g. the sender of the messages a strand decrypts).
+ *
+ * The jobs of one strand run one after another, in the order they were added, so a job sees
+ * everything the earlier jobs of its strand did; different strands run in parallel. take(i) waits
+ * for the result of the i-th job, so a consumer can hand out results in order while later jobs are
+ * still running. The destructor waits for every started strand, so the jobs may reference state
+ * that outlives the OrderedStrands object.
+ *
+ * Example:
+ * @code
+ *   OrderedStrands<std::string> strands(WorkerPool::shared());
+ *   for (const Message& message : messages) {
+ *       strands.add(message.sender, [&message]() { return decrypt(message); });
+ *   }
+ *   strands.start();
+ *   for (size_t i = 0; i < messages.size(); i++) {
+ *       display(strands.take(i));
+ *   }
+ * @endcode
+ */
+template<class Result, class Key = std::string>
+class OrderedStrands {
+public:
+    explicit OrderedStrands(WorkerPool& pool) : _pool(pool), _state(std::make_shared<State>()) {}
+
+    ~OrderedStrands() {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+        _state->changed.wait(lock, [this]() { return _state->runningStrands == 0; });
+    }
+
+    OrderedStrands(const OrderedStrands&) = delete;
+    OrderedStrands& operator=(const OrderedStrands&) = delete;
+
+    /**
+     * @brief Adds a job to the end of a strand. Only allowed before start.
+     *
+     * @param strand The strand key; jobs with equal keys run in order, one at a time.
+     * @param job The job. If it throws, take rethrows the exception for its index.
+     */
+    void add(const Key& strand, std::function<Result()> job) {
+        auto inserted = _strandIndex.try_emplace(strand, _strands.size());
+        if (inserted.second) {
+            _strands.emplace_back();
+        }
+        _strands[inserted.first->second].push_back(_jobs.size());
+        _jobs.push_back(std::move(job));
+    }
+
+    /**
+     * @brief Hands every strand to the pool.
+     */
+    void start() {
+        _state->results.resize(_jobs.size());
+        _state->ready.assign(_jobs.size(), false);
+        _state->runningStrands = _strands.size();
+        for (std::vector<size_t>& strand : _strands) {
+            _pool.post([state = _state, jobs = &_jobs, strand = &strand]() {
+                for (size_t index : *strand) {
+                    Outcome outcome;
+                    try {
+                        outcome.result = (*jobs)[index]();
+                    }
+                    catch (...) {
+                        outcome.error = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->results[index] = std::move(outcome);
+                    state->ready[index] = true;
+                    state->changed.notify_all();
+                }
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->runningStrands--;
+                state->changed.notify_all();
+            });
+        }
+    }
+
+    /**
+     * @brief Waits for the result of the job added index-th, and takes it.
+     *
+     * @throws whatever the job threw.
+     */
+    Result take(size_t index) {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+        _state->changed.wait(lock, [&]() { return _state->ready[index]; });
+        Outcome outcome = std::move(_state->results[index]);
+        lock.unlock();
+        if (outcome.error) {
+            std::rethrow_exception(outcome.error);
+        }
+        return std::move(outcome.result);
+    }
+
+private:
+    struct Outcome {
+        Result result{};
+        std::exception_ptr error;
+    };
+
+    // Shared with the strand jobs, which may finish after this object's owner has stopped taking results.
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<Outcome> results;
+        std::vector<bool> ready;
+        size_t runningStrands = 0;
+    };
+
+    WorkerPool& _pool;
+    std::vector<std::function<Result()>> _jobs;           ///< The jobs, in the order they were added.
+    std::vector<std::vector<size_t>> _strands;            ///< Job indices of each strand, in order.
+    std::unordered_map<Key, size_t> _strandIndex;         ///< Strand key to its index in _strands.
+    std::shared_ptr<State> _state;
+};
\ No newline at end of file
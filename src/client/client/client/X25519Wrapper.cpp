@@ -0,0 +1,65 @@
+#include "X25519Wrapper.h"
+#include "CryptoContext.h"
+
+#include <hkdf.h>
+#include <sha.h>
+
+#include <algorithm>
+
+
+static const char KEY_INFO[] = "MessageU session key";
+
+X25519Wrapper::X25519Wrapper()
+{
+	CryptoPP::RandomNumberGenerator& rng = CryptoContext::instance().rng();
+	CryptoPP::x25519 x25519;
+	x25519.GeneratePrivateKey(rng, _privateKey);
+	x25519.GeneratePublicKey(rng, _privateKey, _publicKey);
+}
+
+X25519Wrapper::X25519Wrapper(const char* key, unsigned int length)
+{
+	if (length != KEYSIZE)
+		throw CryptoPP::InvalidArgument("X25519 private key must be 32 bytes");
+
+	std::copy(key, key + KEYSIZE, _privateKey);
+	CryptoPP::x25519().GeneratePublicKey(CryptoContext::instance().rng(), _privateKey, _publicKey);
+}
+
+X25519Wrapper::X25519Wrapper(const std::string& key) : X25519Wrapper(key.data(), static_cast<unsigned int>(key.size()))
+{
+}
+
+X25519Wrapper::~X25519Wrapper()
+{
+	std::fill(_privateKey, _privateKey + KEYSIZE, 0);
+}
+
+std::string X25519Wrapper::getPrivateKey() const
+{
+	return std::string(reinterpret_cast<const char*>(_privateKey), KEYSIZE);
+}
+
+std::string X25519Wrapper::getPublicKey() const
+{
+	return std::string(reinterpret_cast<const char*>(_publicKey), KEYSIZE);
+}
+
+std::string X25519Wrapper::deriveKey(const char* peerKey, unsigned int peerKeyLength, const std::string& salt, unsigned int length) const
+{
+	if (peerKeyLength != KEYSIZE)
+		throw CryptoPP::InvalidArgument("X25519 public key must be 32 bytes");
+
+	// Agree also rejects the low-order points that would force a known shared secret.
+	CryptoPP::byte secret[CryptoPP::x25519::SHARED_KEYLENGTH];
+	if (!CryptoPP::x25519().Agree(secret, _privateKey, reinterpret_cast<const CryptoPP::byte*>(peerKey)))
+		throw CryptoPP::InvalidArgument("Invalid X25519 public key");
+
+	std::string key(length, '\0');
+	CryptoPP::HKDF<CryptoPP::SHA256> hkdf;
+	hkdf.DeriveKey(reinterpret_cast<CryptoPP::byte*>(&key[0]), key.size(), secret, sizeof(secret),
+		reinterpret_cast<const CryptoPP::byte*>(salt.data()), salt.size(),
+		reinterpret_cast<const CryptoPP::byte*>(KEY_INFO), sizeof(KEY_INFO) - 1);
+	std::fill(secret, secret + sizeof(secret), 0);
+	return key;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <xed25519.h>
+
+#include <string>
+
+
+
+// X25519 key pair for key agreement: two clients derive the same session key from their own private
+// key and the other's public key, so the session key is never sent.
+// deriveKey may be called from several threads at once on the same key.
+class X25519Wrapper
+{
+public:
+	static const unsigned int KEYSIZE = 32;
+
+private:
+	CryptoPP::byte _privateKey[KEYSIZE];
+	CryptoPP::byte _publicKey[KEYSIZE];
+
+	X25519Wrapper(const X25519Wrapper& x25519);
+	X25519Wrapper& operator=(const X25519Wrapper& x25519);
+public:
+	X25519Wrapper();
+	X25519Wrapper(const char* key, unsigned int length);
+	X25519Wrapper(const std::string& key);
+	~X25519Wrapper();
+
+	std::string getPrivateKey() const;
+	std::string getPublicKey() const;
+
+	// Agrees on a secret with the owner of peerKey and derives length bytes from it with HKDF-SHA256.
+	// Both sides must pass the same salt to get the same key.
+	std::string deriveKey(const char* peerKey, unsigned int peerKeyLength, const std::string& salt, unsigned int length) const;
+};
\ No newline at end of file
@@ -0,0 +1,250 @@
+﻿#include "BenchRunner.h"
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+static std::atomic<uint64_t> allocations{ 0 };
+
+// The replaced global allocation functions count every operator new (the array and nothrow forms
+// call these). Crypto++ allocates its aligned blocks with malloc directly, and those are not counted.
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    void* p = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    void* p = std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+uint64_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+BenchRunner::BenchRunner() : BenchRunner(Options()) {
+}
+
+BenchRunner::BenchRunner(Options options) : _options(std::move(options)) {
+}
+
+void BenchRunner::add(std::string name, size_t bytesPerOp, std::function<void()> operation) {
+    _benchmarks.push_back(Benchmark{ std::move(name), bytesPerOp, std::move(operation) });
+}
+
+// Runs the operation `iterations` times and returns the elapsed time in nanoseconds.
+static double timeIterations(const std::function<void()>& operation, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        operation();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+BenchResult BenchRunner::measure(const Benchmark& benchmark) const {
+    // Grow the iteration count until one run takes the minimum time; this also warms the caches
+    // and lets the lazily set-up state (key pools, worker threads) settle.
+    const double minTimeNs = _options.minTimeSeconds * 1e9;
+    uint64_t iterations = 1;
+    while (true) {
+        double elapsed = timeIterations(benchmark.operation, iterations);
+        if (elapsed >= minTimeNs) {
+            break;
+        }
+        double factor = elapsed > 0 ? std::min(10.0, std::max(2.0, 1.2 * minTimeNs / elapsed)) : 10.0;
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * factor);
+    }
+
+    int repetitions = std::max(1, _options.repetitions);
+    std::vector<double> nsPerOp;
+    nsPerOp.reserve(repetitions);
+    uint64_t allocationsBefore = allocationCount();
+    for (int i = 0; i < repetitions; i++) {
+        nsPerOp.push_back(timeIterations(benchmark.operation, iterations) / static_cast<double>(iterations));
+    }
+    uint64_t allocationsDuring = allocationCount() - allocationsBefore;
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    BenchResult result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+    result.bytesPerSecond = benchmark.bytesPerOp > 0 && result.nsPerOp > 0
+        ? static_cast<double>(benchmark.bytesPerOp) * 1e9 / result.nsPerOp : 0;
+    result.allocsPerOp = static_cast<double>(allocationsDuring) / (static_cast<double>(iterations) * repetitions);
+    return result;
+}
+
+// Formats a throughput with a binary unit (e.g. "1.52 GiB/s").
+static std::string formatThroughput(double bytesPerSecond) {
+    if (bytesPerSecond <= 0) {
+        return "-";
+    }
+    static const char* const UNITS[] = { "B/s", "KiB/s", "MiB/s", "GiB/s" };
+    size_t unit = 0;
+    while (bytesPerSecond >= 1024 && unit + 1 < std::size(UNITS)) {
+        bytesPerSecond /= 1024;
+        unit++;
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << bytesPerSecond << " " << UNITS[unit];
+    return text.str();
+}
+
+std::vector<BenchResult> BenchRunner::run(std::ostream& out) const {
+    std::vector<BenchResult> results;
+    out << std::left << std::setw(40) << "benchmark" << std::right << std::setw(16) << "ns/op"
+        << std::setw(16) << "bytes/s" << std::setw(14) << "allocs/op" << "\n";
+    for (const Benchmark& benchmark : _benchmarks) {
+        if (!_options.filter.empty() && benchmark.name.find(_options.filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = measure(benchmark);
+        out << std::left << std::setw(40) << result.name << std::right << std::fixed
+            << std::setw(16) << std::setprecision(1) << result.nsPerOp
+            << std::setw(16) << formatThroughput(result.bytesPerSecond)
+            << std::setw(14) << std::setprecision(2) << result.allocsPerOp << std::endl;
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+// Escapes a string for a JSON string literal (the names and labels are plain text).
+static std::string jsonString(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += (static_cast<unsigned char>(c) < 0x20) ? ' ' : c;
+    }
+    return escaped + "\"";
+}
+
+void BenchRunner::writeJson(const std::string& path, const std::string& label, const std::vector<BenchResult>& results) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Unable to write " + path);
+    }
+    file << "{\n  \"label\": " << jsonString(label) << ",\n  \"benchmarks\": [\n";
+    file << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        file << "    {\"name\": " << jsonString(result.name)
+            << ", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.nsPerOp
+            << ", \"bytes_per_second\": " << result.bytesPerSecond
+            << ", \"allocs_per_op\": " << result.allocsPerOp << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+    if (!file) {
+        throw std::runtime_error("Unable to write " + path);
+    }
+}
+
+// Returns the number after "key": on the line, or 0 if the line has no such key.
+static double jsonNumber(const std::string& line, const std::string& key) {
+    size_t position = line.find("\"" + key + "\":");
+    if (position == std::string::npos) {
+        return 0;
+    }
+    return std::strtod(line.c_str() + position + key.size() + 3, nullptr);
+}
+
+std::vector<BenchResult> BenchRunner::readJson(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to read " + path);
+    }
+    // writeJson puts each benchmark on its own line, so the baseline is read line by line.
+    std::vector<BenchResult> results;
+    std::string line;
+    const std::string nameKey = "{\"name\": \"";
+    while (std::getline(file, line)) {
+        size_t nameStart = line.find(nameKey);
+        if (nameStart == std::string::npos) {
+            continue;
+        }
+        nameStart += nameKey.size();
+        size_t nameEnd = line.find('"', nameStart);
+        if (nameEnd == std::string::npos) {
+            throw std::runtime_error("Malformed benchmark baseline: " + path);
+        }
+        BenchResult result;
+        result.name = line.substr(nameStart, nameEnd - nameStart);
+        result.iterations = static_cast<uint64_t>(jsonNumber(line, "iterations"));
+        result.nsPerOp = jsonNumber(line, "ns_per_op");
+        result.bytesPerSecond = jsonNumber(line, "bytes_per_second");
+        result.allocsPerOp = jsonNumber(line, "allocs_per_op");
+        results.push_back(std::move(result));
+    }
+    if (results.empty()) {
+        throw std::runtime_error("No benchmarks in " + path);
+    }
+    return results;
+}
+
+size_t BenchRunner::compare(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& results,
+    double tolerance, std::ostream& out) {
+    std::unordered_map<std::string, const BenchResult*> byName;
+    for (const BenchResult& result : baseline) {
+        byName[result.name] = &result;
+    }
+    size_t regressions = 0;
+    out << "\n" << std::left << std::setw(40) << "benchmark" << std::right << std::setw(16) << "baseline ns/op"
+        << std::setw(16) << "ns/op" << std::setw(10) << "change" << std::setw(14) << "allocs/op" << "\n";
+    for (const BenchResult& result : results) {
+        auto it = byName.find(result.name);
+        if (it == byName.end() || it->second->nsPerOp <= 0) {
+            out << std::left << std::setw(40) << result.name << std::right << std::setw(16) << "-" << "\n";
+            continue;
+        }
+        const BenchResult& before = *it->second;
+        double change = result.nsPerOp / before.nsPerOp - 1;
+        bool slower = change > tolerance || result.allocsPerOp > before.allocsPerOp + 0.5;
+        regressions += slower ? 1 : 0;
+        std::ostringstream allocs;
+        allocs << std::fixed << std::setprecision(2) << before.allocsPerOp << "->" << result.allocsPerOp;
+        out << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(16) << before.nsPerOp << std::setw(16) << result.nsPerOp
+            << std::setw(9) << std::showpos << change * 100 << std::noshowpos << "%"
+            << std::setw(14) << allocs.str() << (slower ? "  REGRESSION" : "") << "\n";
+    }
+    return regressions;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+﻿#pragma once
+#include "utils.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+
+/**
+ * @brief Number of heap allocations made so far, by any thread.
+ *
+ * It is counted by the replaced global operator new (BenchRunner.cpp), so it is only available in
+ * the benchmark executable.
+ */
+uint64_t allocationCount();
+
+/**
+ * @brief Keeps the compiler from optimizing away a result that is otherwise unused.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * @brief The measurements of one benchmark.
+ */
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0;      ///< Iterations per repetition.
+    double nsPerOp = 0;           ///< Median over the repetitions.
+    double bytesPerSecond = 0;    ///< Bytes processed per second at the median; 0 if the benchmark has no size.
+    double allocsPerOp = 0;       ///< Heap allocations per iteration, over all repetitions.
+};
+
+/**
+ * @brief Runs a set of micro-benchmarks, prints a table and reads/writes JSON baselines.
+ *
+ * Each benchmark is a function that runs one operation. The runner grows the iteration count until
+ * one run takes at least the minimum time, then repeats the run and keeps the median, which is
+ * less sensitive than the mean to a run that was interrupted.
+ *
+ * Example:
+ * @code
+ *   BenchRunner runner;
+ *   runner.add("codec/hex/encode/1024", 1024, [&]() { doNotOptimize(Codec::hexEncode(data, 1024, out)); });
+ *   std::vector<BenchResult> results = runner.run();
+ * @endcode
+ */
+class BenchRunner {
+public:
+    struct Options {
+        double minTimeSeconds = 0.2;  ///< Minimum duration of one repetition.
+        int repetitions = 5;          ///< Number of timed repetitions.
+        std::string filter;           ///< Only benchmarks whose name contains this run.
+    };
+
+    BenchRunner();
+    explicit BenchRunner(Options options);
+
+    /**
+     * @brief Registers a benchmark.
+     *
+     * @param name Name, '/'-separated from the general to the particular (e.g. "aes/cbc/encrypt/1024").
+     * @param bytesPerOp Bytes processed by one operation, for bytes/s; 0 if throughput is meaningless.
+     * @param operation Runs one operation.
+     */
+    void add(std::string name, size_t bytesPerOp, std::function<void()> operation);
+
+    /**
+     * @brief Runs the registered benchmarks that match the filter, printing a line for each.
+     */
+    std::vector<BenchResult> run(std::ostream& out = std::cout) const;
+
+    /**
+     * @brief Writes results as a JSON baseline, one benchmark per line.
+     *
+     * @param label Free-form label stored with the results (e.g. the commit they were measured at).
+     * @throws std::runtime_error if the file can't be written.
+     */
+    static void writeJson(const std::string& path, const std::string& label, const std::vector<BenchResult>& results);
+
+    /**
+     * @brief Reads a baseline written by writeJson.
+     *
+     * @throws std::runtime_error if the file can't be read or is not a baseline.
+     */
+    static std::vector<BenchResult> readJson(const std::string& path);
+
+    /**
+     * @brief Prints the change of each result against the baseline result of the same name.
+     *
+     * @return The number of benchmarks that got slower by more than \p tolerance (0.1 = 10%).
+     */
+    static size_t compare(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& results,
+        double tolerance, std::ostream& out = std::cout);
+
+private:
+    struct Benchmark {
+        std::string name;
+        size_t bytesPerOp;
+        std::function<void()> operation;
+    };
+
+    BenchResult measure(const Benchmark& benchmark) const;
+
+    Options _options;
+    std::vector<Benchmark> _benchmarks;
+};
\ No newline at end of file
@@ -0,0 +1,233 @@
+﻿#include "BenchRunner.h"
+#include "AESWrapper.h"
+#include "ByteWriter.h"
+#include "Codec.h"
+#include "MessageView.h"
+#include "RSAWrapper.h"
+#include "SocketWrapper.h"
+#include "X25519Wrapper.h"
+#include "protocol.h"
+
+// Micro-benchmarks of the client's hot paths: building and parsing protocol messages, parsing a
+// fetched page, AES, RSA-OAEP, X25519 and the codecs.
+//
+// Usage: client_bench [--filter TEXT] [--min-time SECONDS] [--repetitions N]
+//                     [--json FILE [--label TEXT]] [--compare FILE [--tolerance FRACTION]]
+//
+// --json writes the results as a baseline; --compare prints the change against an earlier baseline
+// and exits with 1 if a benchmark got slower by more than the tolerance (default 0.1) or allocates more.
+
+static const size_t MESSAGE_SIZES[] = { 16, 1024, 64 * 1024, 1024 * 1024 };
+static const size_t PAYLOAD_SIZES[] = { 0, 1024, 64 * 1024 };
+static const size_t CODEC_SIZES[] = { 16, 1024, 64 * 1024 };
+
+// Deterministic filler, so runs are comparable.
+static std::string testBytes(size_t length) {
+    std::string bytes(length, '\0');
+    uint32_t state = 0x9E3779B9u;
+    for (char& byte : bytes) {
+        state = state * 1664525u + 1013904223u;
+        byte = static_cast<char>(state >> 24);
+    }
+    return bytes;
+}
+
+// A fetch response payload (2104) of `count` records with `contentSize`-byte contents.
+static std::vector<uint8_t> messagePage(size_t count, size_t contentSize, uint8_t version) {
+    std::string content = testBytes(contentSize);
+    ByteWriter page;
+    for (size_t i = 0; i < count; i++) {
+        page.putPadded("sender-client-id", ClientId::SIZE);
+        page.putUint32(static_cast<uint32_t>(i + 1));
+        page.putUint8(3);
+        if (version >= 2) {
+            page.putUint8(version);
+        }
+        page.putUint32(static_cast<uint32_t>(content.size()));
+        page.putBytes(content);
+    }
+    return page.take();
+}
+
+static void addProtocolBenchmarks(BenchRunner& runner) {
+    static const ClientId clientId = ClientId::fromBytes("0123456789abcdef");
+    for (size_t size : PAYLOAD_SIZES) {
+        std::string bytes = testBytes(size);
+        auto payload = std::make_shared<std::vector<uint8_t>>(bytes.begin(), bytes.end());
+        // What sendRequestAsync builds before sending: the header and the buffer list. The payload is
+        // left in place, so only the header bytes are counted and the cost must not grow with the size.
+        runner.add("protocol/requestBuffers/" + std::to_string(size), Protocol::REQUEST_HEADER_SIZE, [payload]() {
+            auto header = Protocol::createRequestHeader(clientId, 2, 603, static_cast<uint32_t>(payload->size()));
+            ConstBuffer buffers[] = { { header.data(), header.size() }, { payload->data(), payload->size() } };
+            doNotOptimize(buffers);
+        });
+        auto response = std::make_shared<std::vector<uint8_t>>(Protocol::createResponse(2, 2104, *payload));
+        runner.add("protocol/parseResponse/" + std::to_string(size), response->size(), [response]() {
+            doNotOptimize(Protocol::parseResponse(*response));
+        });
+    }
+    runner.add("protocol/createRequestHeader", Protocol::REQUEST_HEADER_SIZE, []() {
+        doNotOptimize(Protocol::createRequestHeader(clientId, 2, 603, 1024));
+    });
+
+    // The fetchMessages payload parser: validating a page and iterating its records.
+    for (uint8_t version : { 1, 2 }) {
+        auto page = std::make_shared<std::vector<uint8_t>>(messagePage(100, 256, version));
+        runner.add("messages/parsePage/v" + std::to_string(version) + "/100x256", page->size(), [page, version]() {
+            size_t contentBytes = 0;
+            for (const MessageView& message : MessageRecords(*page, version)) {
+                contentBytes += message.content.size();
+            }
+            doNotOptimize(contentBytes);
+        });
+    }
+}
+
+static void addAesBenchmarks(BenchRunner& runner) {
+    for (size_t size : MESSAGE_SIZES) {
+        std::string suffix = "/" + std::to_string(size);
+        auto aes = std::make_shared<AESWrapper>();
+        auto plain = std::make_shared<std::string>(testBytes(size));
+
+        // CBC (version 1 contents), through the buffer overloads the client uses.
+        auto cipher = std::make_shared<std::string>(AESWrapper::encryptedSize(size), '\0');
+        aes->encrypt(plain->data(), plain->size(), cipher->data(), cipher->size());
+        auto decrypted = std::make_shared<std::string>(AESWrapper::maxDecryptedSize(cipher->size()), '\0');
+        runner.add("aes/cbc/encrypt" + suffix, size, [aes, plain, cipher]() {
+            doNotOptimize(aes->encrypt(plain->data(), plain->size(), cipher->data(), cipher->size()));
+        });
+        runner.add("aes/cbc/decrypt" + suffix, size, [aes, cipher, decrypted]() {
+            doNotOptimize(aes->decrypt(cipher->data(), cipher->size(), decrypted->data(), decrypted->size()));
+        });
+
+        // Segmented GCM (version 2 contents).
+        auto sealed = std::make_shared<std::string>(AESWrapper::sealedSize(size), '\0');
+        aes->seal(plain->data(), plain->size(), sealed->data(), sealed->size());
+        auto opened = std::make_shared<std::string>(AESWrapper::maxOpenedSize(sealed->size()), '\0');
+        runner.add("aes/gcm/seal" + suffix, size, [aes, plain, sealed]() {
+            doNotOptimize(aes->seal(plain->data(), plain->size(), sealed->data(), sealed->size()));
+        });
+        runner.add("aes/gcm/open" + suffix, size, [aes, sealed, opened]() {
+            doNotOptimize(aes->open(sealed->data(), sealed->size(), opened->data(), opened->size()));
+        });
+    }
+}
+
+static void addKeyBenchmarks(BenchRunner& runner) {
+    // RSA-OAEP as used to send a symmetric key: the 16-byte AES key is encrypted with the peer's key.
+    auto rsaPrivate = std::make_shared<RSAPrivateWrapper>();
+    auto rsaPublic = std::make_shared<RSAPublicWrapper>(rsaPrivate->getPublicKey());
+    auto key = std::make_shared<std::string>(testBytes(AESWrapper::DEFAULT_KEYLENGTH));
+    auto encryptedKey = std::make_shared<std::string>(rsaPublic->encrypt(*key));
+    runner.add("rsa/oaep/encrypt", key->size(), [rsaPublic, key]() {
+        doNotOptimize(rsaPublic->encrypt(*key));
+    });
+    runner.add("rsa/oaep/decrypt", key->size(), [rsaPrivate, encryptedKey]() {
+        doNotOptimize(rsaPrivate->decrypt(*encryptedKey));
+    });
+    runner.add("rsa/keygen/" + std::to_string(RSAPrivateWrapper::BITS), 0, []() {
+        RSAPrivateWrapper generated;
+        doNotOptimize(generated);
+    });
+
+    auto ours = std::make_shared<X25519Wrapper>();
+    auto peerPublicKey = std::make_shared<std::string>(X25519Wrapper().getPublicKey());
+    auto salt = std::make_shared<std::string>(testBytes(2 * ClientId::SIZE));
+    runner.add("x25519/deriveKey", 0, [ours, peerPublicKey, salt]() {
+        doNotOptimize(ours->deriveKey(peerPublicKey->data(), static_cast<unsigned int>(peerPublicKey->size()), *salt,
+            AESWrapper::DEFAULT_KEYLENGTH));
+    });
+}
+
+static void addCodecBenchmarks(BenchRunner& runner) {
+    for (size_t size : CODEC_SIZES) {
+        std::string suffix = "/" + std::to_string(size);
+        auto bytes = std::make_shared<std::string>(testBytes(size));
+
+        auto base64 = std::make_shared<std::string>(Codec::base64EncodedSize(size), '\0');
+        Codec::base64Encode(bytes->data(), bytes->size(), base64->data());
+        auto decoded = std::make_shared<std::string>(Codec::base64MaxDecodedSize(base64->size()), '\0');
+        runner.add("codec/base64/encode" + suffix, size, [bytes, base64]() {
+            doNotOptimize(Codec::base64Encode(bytes->data(), bytes->size(), base64->data()));
+        });
+        runner.add("codec/base64/decode" + suffix, size, [base64, decoded]() {
+            doNotOptimize(Codec::base64Decode(base64->data(), base64->size(), decoded->data(), decoded->size()));
+        });
+
+        auto hex = std::make_shared<std::string>(Codec::hexEncodedSize(size), '\0');
+        Codec::hexEncode(bytes->data(), bytes->size(), hex->data());
+        runner.add("codec/hex/encode" + suffix, size, [bytes, hex]() {
+            doNotOptimize(Codec::hexEncode(bytes->data(), bytes->size(), hex->data()));
+        });
+        runner.add("codec/hex/decode" + suffix, size, [hex, decoded]() {
+            doNotOptimize(Codec::hexDecode(hex->data(), hex->size(), decoded->data(), decoded->size()));
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchRunner::Options options;
+    std::string jsonPath, comparePath, label;
+    double tolerance = 0.1;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << argument << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (argument == "--filter") {
+            options.filter = value;
+        }
+        else if (argument == "--min-time") {
+            options.minTimeSeconds = std::stod(value);
+        }
+        else if (argument == "--repetitions") {
+            options.repetitions = std::stoi(value);
+        }
+        else if (argument == "--json") {
+            jsonPath = value;
+        }
+        else if (argument == "--label") {
+            label = value;
+        }
+        else if (argument == "--compare") {
+            comparePath = value;
+        }
+        else if (argument == "--tolerance") {
+            tolerance = std::stod(value);
+        }
+        else {
+            std::cerr << "Unknown option " << argument << std::endl;
+            return 2;
+        }
+    }
+
+    try {
+        // Read the baseline first, so a bad path fails before the run rather than after it.
+        std::vector<BenchResult> baseline;
+        if (!comparePath.empty()) {
+            baseline = BenchRunner::readJson(comparePath);
+        }
+
+        BenchRunner runner(options);
+        addProtocolBenchmarks(runner);
+        addAesBenchmarks(runner);
+        addKeyBenchmarks(runner);
+        addCodecBenchmarks(runner);
+        std::vector<BenchResult> results = runner.run();
+
+        if (!jsonPath.empty()) {
+            BenchRunner::writeJson(jsonPath, label, results);
+            std::cout << "Baseline written to " << jsonPath << std::endl;
+        }
+        if (!comparePath.empty() && BenchRunner::compare(baseline, results, tolerance) > 0) {
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -1,36 +1,114 @@
 ﻿#include "utils.h"
 #include "client.h"
+#include "AsyncSocket.h"
+#include "WorkerPool.h"
 
 // Constants for fixed field sizes
-static const size_t CLIENT_ID_SIZE = 16;
-static const size_t USERNAME_SIZE = 255;
-static const size_t REGISTRATION_PAYLOAD_SIZE = USERNAME_SIZE + 160; // 415 bytes
+static const size_t CLIENT_ID_SIZE = ClientId::SIZE;
+static_assert(Wire::RequestHeader::ClientId::size == ClientId::SIZE);
+static const size_t USERNAME_SIZE = Wire::Registration::UserName::size;
+static const size_t MESSAGE_HEADER_SIZE = Wire::MessageHeader::SIZE;
+static_assert(Wire::Registration::PublicKey::size == X25519Wrapper::KEYSIZE);
+static const char KEY_REQUEST_CONTENT[] = "Request for symetric key";
+static const size_t FILE_CHUNK_HEADER_SIZE = Wire::FileChunkHeader::SIZE;
+static const uint8_t FILE_MESSAGE_TYPE = 4;
+static const uint32_t DEFAULT_FETCH_PAGE_MAX_COUNT = 64;
+static const uint32_t DEFAULT_FETCH_PAGE_MAX_BYTES = 1024 * 1024;
+
+static const char DIRECTORY_CACHE_FILE[] = "directory.cache";
+static const char PUBLIC_KEY_CACHE_FILE[] = "publickeys.cache";
+static const char PEER_VERSION_CACHE_FILE[] = "peerversions.cache";
+static const char PEER_VERSION_CACHE_MAGIC[4] = { 'M', 'U', 'V', '1' };
+
+// Whether sending a request twice has the same effect as sending it once: the reads, and the page
+// fetch, whose acknowledgement deletes the same messages again. Registration and the sends
+// (603, 605, 606) would be duplicated, and the legacy fetch (604) deletes what it returns.
+static bool isRepeatable(uint16_t requestCode) {
+    return requestCode == 601 || requestCode == 602 || requestCode == 607 || requestCode == 608;
+}
+
+// Appends the message sub-header (Wire::MessageHeader).
+static void putMessageHeader(ByteWriter& out, const ClientId& toClientId, const ClientId& fromClientId,
+    uint8_t messageType, uint32_t contentSize) {
+    using Header = Wire::MessageHeader;
+    uint8_t* header = out.putSpace(Header::SIZE);
+    Header::ToClientId::put(header, toClientId.view());
+    Header::FromClientId::put(header, fromClientId.view());
+    Header::Type::put(header, messageType);
+    Header::ContentSize::put(header, contentSize);
+}
+
+// Parses the per-message status records (Wire::SendStatus) of a 2105/2106 response, in request order;
+// status 0 means stored.
+static std::vector<MessageSendStatus> parseSendStatuses(const std::vector<uint8_t>& payload, size_t expectedCount) {
+    using Record = Wire::SendStatus;
+    if (payload.size() != expectedCount * Record::SIZE) {
+        throw std::runtime_error("Response does not match the number of messages sent.");
+    }
+    std::vector<MessageSendStatus> statuses(expectedCount);
+    for (size_t i = 0; i < expectedCount; i++) {
+        const uint8_t* record = payload.data() + i * Record::SIZE;
+        uint32_t messageId = Record::MessageId::get(record);
+        statuses[i].stored = (Record::Status::get(record) == 0);
+        statuses[i].messageId = statuses[i].stored ? messageId : 0;
+    }
+    return statuses;
+}
+
+// Text and file contents are AES-CBC encrypted in protocol version 1 and AES-GCM sealed from version 2 on.
+static size_t encryptedContentSize(uint8_t version, size_t plainLength) {
+    return version >= 2 ? AESWrapper::sealedSize(plainLength) : AESWrapper::encryptedSize(plainLength);
+}
+
+static size_t encryptContent(AESWrapper& aes, uint8_t version, const char* plain, size_t length, char* out, size_t outSize) {
+    return version >= 2 ? aes.seal(plain, length, out, outSize) : aes.encrypt(plain, length, out, outSize);
+}
+
+static std::string decryptContent(AESWrapper& aes, uint8_t version, std::string_view content) {
+    return version >= 2 ? aes.open(content.data(), content.size())
+        : aes.decrypt(content.data(), static_cast<unsigned int>(content.size()));
+}
+
 
 // -----------------------------
 // Constructor & Destructor
 // -----------------------------
-Client::Client() : _rsaPrivate() {
+Client::Client() : _persistentConnection(true), _maxFrameSize(SocketWrapper::DEFAULT_MAX_FRAME_SIZE),
+    _fetchPageMaxCount(DEFAULT_FETCH_PAGE_MAX_COUNT), _fetchPageMaxBytes(DEFAULT_FETCH_PAGE_MAX_BYTES) {
     serverInfo = readServerInfo();
     _serverIp = std::get<0>(serverInfo);
     _serverPort = std::get<1>(serverInfo);
 
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        std::cerr << "Failed to initialize Winsock!" << std::endl;
+    try {
+        SocketWrapper::initializeNetwork();
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
         exit(EXIT_FAILURE);
     }
+
+    _pool = std::make_unique<ConnectionPool>(_serverIp, _serverPort, readConnectionPoolConfig());
+    _pool->warmUp();
+
+    // The users known from the previous run; the first sync only downloads the ones added since.
+    _users.loadCache(getPathInExeDirectory(DIRECTORY_CACHE_FILE));
+    _publicKeys.load(getPathInExeDirectory(PUBLIC_KEY_CACHE_FILE));
+    loadPeerVersions();
+
+    loadIdentity();
 }
 
 Client::~Client() {
-    WSACleanup();
+    // Pooled connections must be closed before the socket library is shut down.
+    _pool.reset();
+    SocketWrapper::cleanupNetwork();
 }
 
 // -----------------------------
 // Server Information & Registration Helpers
 // -----------------------------
 std::tuple<std::string, unsigned short> Client::readServerInfo() {
-    std::string exeDir = getExeDirectory();
-    std::string serverFilePath = exeDir + "\\server.info";
+    std::string serverFilePath = getPathInExeDirectory("server.info");
     std::ifstream serverFile(serverFilePath);
     if (!serverFile.is_open()) {
         throw std::runtime_error("Cannot open server.info file: " + serverFilePath);
@@ -58,49 +136,163 @@ std::tuple<std::string, unsigned short> Client::readServerInfo() {
     return { ip, port };
 }
 
-std::vector<uint8_t> Client::buildRegistrationPayload(const std::string& username) {
-    // Retrieve the raw RSA public key (should be 160 bytes for RSA-1024)
-    std::string pubKeyRaw = _rsaPrivate.getPublicKey();
-    // No Base64 decoding: the key is returned in binary format.
-    std::string pubKeyBin = pubKeyRaw;
-
-    if (pubKeyBin.size() < 160) {
-        //std::cerr << "Error: Public key is too short"<< std::endl;
-		throw std::runtime_error("Public key is too short");
-        return {};
-    }
-    if (pubKeyBin.size() > 160) {
-        pubKeyBin = pubKeyBin.substr(0, 160);
+ConnectionPoolConfig Client::readConnectionPoolConfig() {
+    std::string serverFilePath = getPathInExeDirectory("server.info");
+    std::ifstream serverFile(serverFilePath);
+    if (!serverFile.is_open()) {
+        throw std::runtime_error("Cannot open server.info file: " + serverFilePath);
     }
 
-    // Create a 255-byte username buffer, null-padded.
-    std::vector<uint8_t> nameBuffer(USERNAME_SIZE, '\0');
-    size_t copyLen = std::min(username.size(), static_cast<size_t>(USERNAME_SIZE - 1));
-    for (size_t i = 0; i < copyLen; i++) {
-        nameBuffer[i] = static_cast<uint8_t>(username[i]);
+    // The first line holds the server address; optional "key=value" settings follow it.
+    ConnectionPoolConfig config;
+    std::string line;
+    std::getline(serverFile, line);
+    while (std::getline(serverFile, line)) {
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        auto pos = line.find('=');
+        if (pos == std::string::npos) {
+            throw std::runtime_error("server.info format error: missing '=' in line: " + line);
+        }
+        std::string key = trim(line.substr(0, pos));
+        std::string value = trim(line.substr(pos + 1));
+        long number = 0;
+        try {
+            number = std::stol(value);
+        }
+        catch (...) {
+            throw std::runtime_error("Invalid value for " + key + " in server.info: " + value);
+        }
+        if (number < 0) {
+            throw std::runtime_error("Negative value for " + key + " in server.info: " + value);
+        }
+
+        if (key == "poolSize") {
+            config.poolSize = static_cast<size_t>(number);
+        }
+        else if (key == "idleTimeout") {
+            config.idleTimeout = std::chrono::seconds(number);
+        }
+        else if (key == "healthCheck") {
+            config.healthCheck = (number != 0);
+        }
+        else {
+            throw std::runtime_error("Unknown setting in server.info: " + key);
+        }
     }
+    return config;
+}
 
-    // Combine the username and public key to form the registration payload.
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), nameBuffer.begin(), nameBuffer.end());
-    payload.insert(payload.end(), pubKeyBin.begin(), pubKeyBin.end());
+void Client::buildRegistrationPayload(const std::string& username, ByteWriter& payload) {
+    // New identities use X25519; generating the key pair takes far less than an RSA key pair.
+    if (!_agreementKey) {
+        _agreementKey = std::make_unique<X25519Wrapper>();
+    }
+    // No Base64 decoding: the key is returned in binary format (32 bytes).
+    std::string pubKeyBin = _agreementKey->getPublicKey();
 
-    if (payload.size() != REGISTRATION_PAYLOAD_SIZE) {
+    // A 255-byte username field, null-padded (and always null-terminated), followed by the public key.
+    using Layout = Wire::Registration;
+    if (pubKeyBin.size() != Layout::PublicKey::size) {
         //std::cerr << "Error: Registration payload size is incorrect" << std::endl;
 		throw std::runtime_error("Registration payload size is incorrect");
-        return {};
     }
-    return payload;
+    uint8_t* record = payload.putSpace(Layout::SIZE);
+    Layout::UserName::put(record, std::string_view(username).substr(0, USERNAME_SIZE - 1));
+    Layout::PublicKey::put(record, pubKeyBin);
 }
 
 bool Client::updateClientIdFromResponse(const std::vector<uint8_t>& response) {
     if (response.size() < CLIENT_ID_SIZE)
         return false;
-    _clientId = std::string(response.begin(), response.begin() + CLIENT_ID_SIZE);
+    _clientId = ClientId(response.data());
     std::cout << "ClientID successfully updated" << "\n";
     return true;
 }
 
+bool Client::loadIdentity() {
+    std::string meInfoFilePath = getPathInExeDirectory("me.info");
+    std::ifstream meInfoFile(meInfoFilePath);
+    if (!meInfoFile.is_open()) {
+        return false;
+    }
+    // Line 1: username, line 2: client ID in hex, then the Base64 private key (which may span several lines).
+    std::string username;
+    std::string hexId;
+    std::getline(meInfoFile, username);
+    std::getline(meInfoFile, hexId);
+    std::string privateKeyBase64;
+    std::string line;
+    while (std::getline(meInfoFile, line)) {
+        privateKeyBase64 += trim(line);
+    }
+    username = trim(username);
+    std::string clientId;
+    try {
+        clientId = Codec::hexDecode(trim(hexId));
+    }
+    catch (const std::invalid_argument&) {
+    }
+    if (username.empty() || clientId.size() != CLIENT_ID_SIZE || privateKeyBase64.empty()) {
+        throw std::runtime_error("me.info is malformed: " + meInfoFilePath);
+    }
+    std::string privateKeyBytes;
+    try {
+        privateKeyBytes = Codec::base64Decode(privateKeyBase64);
+    }
+    catch (const std::invalid_argument&) {
+        throw std::runtime_error("me.info is malformed: " + meInfoFilePath);
+    }
+    _username = username;
+    _clientId = ClientId::fromBytes(clientId);
+    // A 32-byte key is an X25519 key, which is cheap to load; an RSA key is parsed on first use.
+    if (privateKeyBytes.size() == X25519Wrapper::KEYSIZE) {
+        _agreementKey = std::make_unique<X25519Wrapper>(privateKeyBytes);
+    }
+    else {
+        _rsaPrivateKeyBytes = std::move(privateKeyBytes);
+    }
+    return true;
+}
+
+RSAPrivateWrapper& Client::privateKey() {
+    if (!_rsaPrivate) {
+        if (!_rsaPrivateKeyBytes.empty()) {
+            try {
+                _rsaPrivate = std::make_unique<RSAPrivateWrapper>(_rsaPrivateKeyBytes);
+            }
+            catch (const CryptoPP::Exception& e) {
+                throw std::runtime_error(std::string("Invalid private key in me.info: ") + e.what());
+            }
+            _rsaPrivateKeyBytes.clear();
+        }
+        else {
+            throw std::runtime_error("No private key available.");
+        }
+    }
+    return *_rsaPrivate;
+}
+
+bool Client::isRegistered() const {
+    return !_username.empty();
+}
+
+const std::string& Client::username() const {
+    return _username;
+}
+
+uint8_t Client::peerVersion(const ClientId& peerId) const {
+    // Only clients that read version 2 have X25519 keys, so an agreed key never encrypts CBC contents.
+    if (_agreedPeers.count(peerId) != 0) {
+        return PROTOCOL_VERSION;
+    }
+    // Otherwise only a peer whose latest message was version 1 is known to run a client without GCM.
+    auto it = _peerVersions.find(peerId);
+    return it == _peerVersions.end() ? PROTOCOL_VERSION : std::min(it->second, PROTOCOL_VERSION);
+}
+
 void Client::writeRegistrationInfoToFile(const std::string& username, const std::string& fileName) {
     std::string filePath = createFileInExeDir(fileName);
     if (filePath.empty()) {
@@ -111,25 +303,26 @@ void Client::writeRegistrationInfoToFile(const std::string& username, const std:
         throw std::runtime_error("Unable to open file: " + fileName);
     }
     meInfoFile << username << "\n";
-    std::string hexId = bytesToHex(_clientId);
+    std::string hexId = Codec::hexEncode(_clientId.view());
     meInfoFile << hexId << "\n";
-    std::string privateKeyBase64 = Base64Wrapper::encode(_rsaPrivate.getPrivateKey());
+    std::string privateKeyBase64 = Codec::base64Encode(_agreementKey ? _agreementKey->getPrivateKey() : privateKey().getPrivateKey());
     meInfoFile << privateKeyBase64 << "\n";
     meInfoFile.close();
 }
 
 // -----------------------------
-// Public Client Functions
+// Public Client Functions (asynchronous)
 // -----------------------------
-bool Client::registerClient(const std::string& username) {
+Task<bool> Client::registerClientAsync(std::string username) {
     if (!checkMeInfoFileMissing()) {
         //std::cerr << "Error: me.info already exists! Could not add a new user." << std::endl;
         throw std::runtime_error("me.info already exists! Could not add a new user.");
-        return false;
+        co_return false;
     }
 
-    std::vector<uint8_t> requestPayload = buildRegistrationPayload(username);
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(600, requestPayload);
+    ByteWriterPool::Lease requestPayload = _writers.acquire();
+    buildRegistrationPayload(username, *requestPayload);
+    std::vector<uint8_t> response = co_await sendRequestAsync(600, *requestPayload);
 
     uint8_t respVersion;
     uint16_t respCode;
@@ -140,73 +333,56 @@ bool Client::registerClient(const std::string& username) {
     catch (const std::exception& e) {
         //std::cerr << e.what() << std::endl;
 		throw std::runtime_error(e.what());
-        return false;
+        co_return false;
     }
     if (respCode != 2100) {
         //std::cerr << std::string(respPayload.begin(), respPayload.end()) << std::endl;
         throw std::runtime_error("Registration failed");
-        return false;
+        co_return false;
     }
     if (respPayload.size() < CLIENT_ID_SIZE) {
         //std::cerr << "Error: Response payload is too short" << std::endl;
         throw std::runtime_error("Response payload is too short!");
-        return false;
+        co_return false;
     }
-    _clientId = std::string(respPayload.begin(), respPayload.begin() + CLIENT_ID_SIZE);
+    _clientId = ClientId(respPayload.data());
+    _username = username;
     std::cout << "Registration of a new user ended successfully." << std::endl;
     writeRegistrationInfoToFile(username, "me.info");
-    return true;
+    co_return true;
 }
 
-void Client::requestClientsList() {
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(601, {});
-    if (response.empty()) {
-        //std::cerr << "No response received for clients list!\n";
-		throw std::runtime_error("No response received for clients list!");
-        return;
-    }
-    uint8_t version;
-    uint16_t code;
-    std::vector<uint8_t> payload;
-    std::tie(version, code, payload) = Protocol::parseResponse(response);
-    if (code != 2101) {
-        //std::cerr << "Error: server responded with code " << code << "\n";
-		throw std::runtime_error("Server responded with code " + std::to_string(code));
-        return;
-    }
-    const size_t RECORD_SIZE = CLIENT_ID_SIZE + USERNAME_SIZE; // 16 + 255 = 271 bytes
-    size_t count = payload.size() / RECORD_SIZE;
+Task<void> Client::requestClientsListAsync() {
+    co_await syncDirectoryAsync();
     std::cout << "\nClients list:\n";
-    userMap.clear();
-    for (size_t i = 0; i < count; i++) {
-        size_t offset = i * RECORD_SIZE;
-        const uint8_t* recPtr = payload.data() + offset;
-        std::string idRaw(reinterpret_cast<const char*>(recPtr), CLIENT_ID_SIZE);
-        std::string userName(reinterpret_cast<const char*>(recPtr + CLIENT_ID_SIZE), USERNAME_SIZE);
-        // Trim any extra null or whitespace characters.
-        userName = trim(userName.c_str());
-        std::cout << userName << "\n";
-        userMap[userName] = idRaw;
+    for (size_t i = 0; i < _users.size(); i++) {
+        std::cout << _users.userName(i) << "\n";
     }
 }
 
-std::string Client::getPublicKey(const std::string& userName) {
-    if (userMap.empty()) {
-        updateUserMap();
+Task<std::shared_ptr<const PeerKey>> Client::peerPublicKeyAsync(std::string userName) {
+    const ClientId* found = _users.findClientId(userName);
+    if (!found) {
+        // The user may have registered since the last sync.
+        co_await syncDirectoryAsync();
+        found = _users.findClientId(userName);
     }
-    auto it = userMap.find(userName);
-    if (it == userMap.end()) {
+    if (!found) {
         //std::cerr << "No ID found for user: " << userName << "\n";
 		throw std::runtime_error("No ID found for user: " + userName);
-        return "";
     }
-    std::string idBytes = it->second;
-    std::vector<uint8_t> requestPayload(idBytes.begin(), idBytes.end());
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(602, requestPayload);
+    // Copied, because the directory may be reloaded while the request is in progress.
+    ClientId clientId = *found;
+    if (std::shared_ptr<const PeerKey> cached = _publicKeys.find(clientId)) {
+        co_return cached;
+    }
+
+    ByteWriterPool::Lease requestPayload = _writers.acquire(CLIENT_ID_SIZE);
+    requestPayload->putBytes(clientId.data(), clientId.size());
+    std::vector<uint8_t> response = co_await sendRequestAsync(602, *requestPayload);
     if (response.empty()) {
         //std::cerr << "No response from server\n";
 		throw std::runtime_error("No response from server");
-        return "";
     }
     uint8_t respVersion;
     uint16_t respCode;
@@ -215,72 +391,103 @@ std::string Client::getPublicKey(const std::string& userName) {
     if (respCode != 2102) {
         //std::cerr << "Server error code: " << respCode << "\n";
 		throw std::runtime_error("Server error code: " + std::to_string(respCode));
-        return "";
     }
-    // Convert the raw public key to Base64 for display.
-    std::string pubKeyBin(reinterpret_cast<char*>(respPayload.data()), respPayload.size());
-    return Base64Wrapper::encode(pubKeyBin);
+    std::shared_ptr<const PeerKey> key;
+    try {
+        key = _publicKeys.insert(clientId, std::string_view(reinterpret_cast<const char*>(respPayload.data()), respPayload.size()));
+    }
+    catch (const CryptoPP::Exception& e) {
+        throw std::runtime_error(e.what());
+    }
+    savePublicKeyCache();
+    co_return key;
 }
 
-void Client::sendSymmetricKey(const std::string& recipient, const std::string& publicKey) {
-    // Retrieve and adjust the recipient's client ID (16 bytes).
-    auto it = userMap.find(recipient);
-    if (it == userMap.end()) {
+Task<std::string> Client::getPublicKeyAsync(std::string userName) {
+    std::shared_ptr<const PeerKey> key = co_await peerPublicKeyAsync(userName);
+    co_return key->bytes();
+}
+
+Task<void> Client::sendSymmetricKeyAsync(std::string recipient) {
+    std::shared_ptr<const PeerKey> key = co_await peerPublicKeyAsync(recipient);
+    co_await sendSymmetricKeyWithAsync(recipient, key);
+}
+
+Task<void> Client::sendSymmetricKeyAsync(std::string recipient, std::string publicKey) {
+    // Retrieve the recipient's client ID.
+    const ClientId* toClientId = _users.findClientId(recipient);
+    if (!toClientId) {
         //std::cerr << "Error: Recipient '" << recipient << "' not found in user list.\n";
 		throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
-        return;
+        co_return;
     }
-    std::string toClientId = adjustToSize(it->second, CLIENT_ID_SIZE);
-
-    // Adjust the sender's client ID.
-    std::string fromClientId = adjustToSize(_clientId, CLIENT_ID_SIZE);
 
-    // Decode the provided public key; note that publicKey is expected to be Base64-encoded.
-    std::string decodedPub = Base64Wrapper::decode(publicKey);
-    if (decodedPub.size() < 160) {
+    // The public key is in binary form, as getPublicKey returns it.
+    if (publicKey.size() != X25519Wrapper::KEYSIZE && publicKey.size() < RSAPublicWrapper::KEYSIZE) {
         //std::cerr << "Public key is too short\n";
 		throw std::runtime_error("Public key is too short");
-        return;
+        co_return;
+    }
+
+    // The cache hands back the already parsed key if it is the one it holds for the recipient.
+    std::shared_ptr<const PeerKey> key;
+    try {
+        key = _publicKeys.insert(*toClientId, publicKey);
+    }
+    catch (const CryptoPP::Exception& e) {
+		throw std::runtime_error(e.what());
+    }
+    savePublicKeyCache();
+    co_await sendSymmetricKeyWithAsync(recipient, key);
+}
+
+Task<void> Client::sendSymmetricKeyWithAsync(std::string recipient, std::shared_ptr<const PeerKey> publicKey) {
+    const ClientId* found = _users.findClientId(recipient);
+    if (!found) {
+		throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
+    }
+    ClientId toClientId = *found;
+
+    // Two X25519 clients derive the same key on their own; there is nothing to send.
+    if (publicKey->isAgreementKey()) {
+        if (!_agreementKey) {
+            throw std::runtime_error("'" + recipient + "' uses X25519 key agreement and can't receive an RSA-sent key; ask them to send theirs.");
+        }
+        agreeSessionKey(toClientId, *publicKey);
+        std::cout << "Symmetric key agreed with '" << recipient << "'." << "\n";
+        co_return;
     }
 
     std::string encryptedKey;
-    AESWrapper aes;
+    auto aes = std::make_shared<AESWrapper>();
     try {
-        RSAPublicWrapper rsaPub(decodedPub);
         // Encrypt the AES key using RSA encryption.
-        encryptedKey = rsaPub.encrypt(std::string(reinterpret_cast<char*>(const_cast<unsigned char*>(aes.getKey())), AESWrapper::DEFAULT_KEYLENGTH));
+        encryptedKey = publicKey->rsa->encrypt(std::string(reinterpret_cast<const char*>(aes->getKey()), AESWrapper::DEFAULT_KEYLENGTH));
     }
     catch (const CryptoPP::Exception& e) {
         //std::cerr << "Error: " << e.what() << std::endl;
 		throw std::runtime_error(e.what());
-        return;
+        co_return;
     }
     catch (...) {
         //std::cerr << "Unknown error in encryption" << std::endl;
         throw std::runtime_error("Unknown error in encryption");
-        return;
+        co_return;
     }
 
     // Save the AES key for later operations.
-    _symmetricKeys[recipient] = aes;
+    _symmetricKeys[toClientId] = aes;
 
-    // Build the payload: [16 bytes toClientId][16 bytes fromClientId][1 byte messageType][4 bytes contentSize][encrypted key]
+    // Send the payload: [37 bytes message header][encrypted key].
     uint8_t messageType = 2; // Symmetric key message
-    uint32_t contentSize = static_cast<uint32_t>(encryptedKey.size());
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), toClientId.begin(), toClientId.end());
-    payload.insert(payload.end(), fromClientId.begin(), fromClientId.end());
-    payload.push_back(messageType);
-    for (int i = 0; i < 4; i++) {
-        payload.push_back((contentSize >> (8 * i)) & 0xFF);
-    }
-    payload.insert(payload.end(), encryptedKey.begin(), encryptedKey.end());
-
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(603, payload);
+    ByteWriterPool::Lease payload = _writers.acquire(MESSAGE_HEADER_SIZE + encryptedKey.size());
+    putMessageHeader(*payload, toClientId, _clientId, messageType, static_cast<uint32_t>(encryptedKey.size()));
+    payload->putBytes(encryptedKey);
+    std::vector<uint8_t> response = co_await sendRequestAsync(603, *payload);
     if (response.empty()) {
         //std::cerr << "No response received from server.\n";
 		throw std::runtime_error("No response received from server.");
-        return;
+        co_return;
     }
     uint8_t respVersion;
     uint16_t respCode;
@@ -299,47 +506,79 @@ void Client::sendSymmetricKey(const std::string& recipient, const std::string& p
     }
 }
 
+Task<std::shared_ptr<AESWrapper>> Client::sessionKeyAsync(std::string userName) {
+    if (const ClientId* clientId = _users.findClientId(userName)) {
+        auto symIt = _symmetricKeys.find(*clientId);
+        if (symIt != _symmetricKeys.end()) {
+            co_return symIt->second;
+        }
+    }
+    if (!_agreementKey) {
+        co_return nullptr;
+    }
+    // This syncs the directory if the user is not in it yet, and throws if they are not registered.
+    std::shared_ptr<const PeerKey> peerKey = co_await peerPublicKeyAsync(userName);
+    const ClientId* clientId = _users.findClientId(userName);
+    if (!peerKey->isAgreementKey() || !clientId) {
+        // An RSA peer has to be sent a key (or send one).
+        co_return nullptr;
+    }
+    co_return agreeSessionKey(*clientId, *peerKey);
+}
 
-void Client::sendMessage(const std::string& recipient, const std::string& message) {
-    // Verify that a symmetric key exists for the recipient.
-    auto symIt = _symmetricKeys.find(recipient);
-    if (symIt == _symmetricKeys.end()) {
+std::shared_ptr<AESWrapper> Client::agreeSessionKey(const ClientId& peerClientId, const PeerKey& peerKey) {
+    if (!_agreementKey) {
+        throw std::runtime_error("No X25519 key available.");
+    }
+    // Salting with both IDs binds the key to the pair; the byte order makes it the same on both sides.
+    std::string salt(std::min(_clientId, peerClientId).view());
+    salt += std::max(_clientId, peerClientId).view();
+    std::string key;
+    try {
+        key = _agreementKey->deriveKey(peerKey.agreementKey.data(), static_cast<unsigned int>(peerKey.agreementKey.size()),
+            salt, AESWrapper::DEFAULT_KEYLENGTH);
+    }
+    catch (const CryptoPP::Exception& e) {
+        throw std::runtime_error(e.what());
+    }
+    auto aes = std::make_shared<AESWrapper>(reinterpret_cast<const unsigned char*>(key.data()), static_cast<unsigned int>(key.size()));
+    _symmetricKeys[peerClientId] = aes;
+    _agreedPeers.insert(peerClientId);
+    return aes;
+}
+
+Task<void> Client::sendMessageAsync(std::string recipient, std::string message) {
+    // Verify that a symmetric key exists for the recipient (or can be agreed on).
+    std::shared_ptr<AESWrapper> symmetricKey = co_await sessionKeyAsync(recipient);
+    if (!symmetricKey) {
         //std::cerr << "No symmetric key for recipient '" << recipient << "'!\n";
         throw std::runtime_error("Can't decrypt message '" + recipient + "'");
-        return;
+        co_return;
     }
 
-    // Retrieve and adjust the recipient's and sender's client IDs.
-    auto it = userMap.find(recipient);
-    if (it == userMap.end()) {
-        //std::cerr << "Error: Recipient '" << recipient << "' not found in userMap.\n";
-        throw std::runtime_error("Recipient '" + recipient + "' not found in userMap.");
-        return;
+    // Retrieve the recipient's client ID.
+    const ClientId* found = _users.findClientId(recipient);
+    if (!found) {
+        //std::cerr << "Error: Recipient '" << recipient << "' not found in user list.\n";
+        throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
+        co_return;
     }
-    std::string toClientId = adjustToSize(it->second, CLIENT_ID_SIZE);
-    std::string fromClientId = adjustToSize(_clientId, CLIENT_ID_SIZE);
+    ClientId toClientId = *found;
 
-    // Encrypt the message using the symmetric AES key.
-    AESWrapper& aes = symIt->second;
-    std::string encryptedMessage = aes.encrypt(message.c_str(), message.size());
-    uint32_t contentSize = static_cast<uint32_t>(encryptedMessage.size());
+    // Build the payload: [37 bytes message header][encrypted message], the message encrypted with the
+    // symmetric AES key, in the mode the recipient understands, straight into its place.
+    AESWrapper& aes = *symmetricKey;
+    uint8_t version = peerVersion(toClientId);
+    size_t encryptedSize = encryptedContentSize(version, message.size());
     uint8_t messageType = 3; // Text message
-
-    // Build the payload: [16 bytes toClientId][16 bytes fromClientId][1 byte messageType][4 bytes contentSize][encrypted message]
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), toClientId.begin(), toClientId.end());
-    payload.insert(payload.end(), fromClientId.begin(), fromClientId.end());
-    payload.push_back(messageType);
-    for (int i = 0; i < 4; i++) {
-        payload.push_back((contentSize >> (8 * i)) & 0xFF);
-    }
-    payload.insert(payload.end(), encryptedMessage.begin(), encryptedMessage.end());
-
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(603, payload);
+    ByteWriterPool::Lease payload = _writers.acquire(MESSAGE_HEADER_SIZE + encryptedSize);
+    putMessageHeader(*payload, toClientId, _clientId, messageType, static_cast<uint32_t>(encryptedSize));
+    encryptContent(aes, version, message.data(), message.size(), reinterpret_cast<char*>(payload->putSpace(encryptedSize)), encryptedSize);
+    std::vector<uint8_t> response = co_await sendRequestAsync(603, *payload, version);
     if (response.empty()) {
         //std::cerr << "No response from server for sendMessage.\n";
         throw std::runtime_error("server responded with an error.");
-        return;
+        co_return;
     }
     uint8_t respVersion;
     uint16_t respCode;
@@ -357,184 +596,676 @@ void Client::sendMessage(const std::string& recipient, const std::string& messag
     }
 }
 
-void Client::fetchMessages() {
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(604, {});
+Task<std::vector<MessageSendStatus>> Client::sendMessagesAsync(std::vector<OutgoingMessage> messages) {
+    // Check everything first, so a missing key or recipient fails the batch before anything is sent.
+    // The whole batch goes with one version, the one every recipient understands.
+    std::vector<std::shared_ptr<AESWrapper>> keys;
+    keys.reserve(messages.size());
+    std::vector<ClientId> recipientIds;
+    recipientIds.reserve(messages.size());
+    uint8_t version = PROTOCOL_VERSION;
+    for (const OutgoingMessage& message : messages) {
+        std::shared_ptr<AESWrapper> symmetricKey = co_await sessionKeyAsync(message.recipient);
+        if (!symmetricKey) {
+            throw std::runtime_error("Can't decrypt message '" + message.recipient + "'");
+        }
+        const ClientId* recipientId = _users.findClientId(message.recipient);
+        if (!recipientId) {
+            throw std::runtime_error("Recipient '" + message.recipient + "' not found in user list.");
+        }
+        keys.push_back(std::move(symmetricKey));
+        recipientIds.push_back(*recipientId);
+        version = std::min(version, peerVersion(*recipientId));
+    }
+    // The cipher text sizes are known up front, so the whole batch is sized once.
+    size_t payloadSize = 0;
+    for (const OutgoingMessage& message : messages) {
+        payloadSize += MESSAGE_HEADER_SIZE + encryptedContentSize(version, message.text.size());
+    }
+
+    // Build the batch in one buffer: [37 bytes message header][encrypted message] per record,
+    // each message encrypted straight into its place.
+    uint8_t messageType = 3; // Text message
+    ByteWriterPool::Lease payload = _writers.acquire(payloadSize);
+    for (size_t i = 0; i < messages.size(); i++) {
+        const std::string& text = messages[i].text;
+        size_t encryptedSize = encryptedContentSize(version, text.size());
+        putMessageHeader(*payload, recipientIds[i], _clientId, messageType,
+            static_cast<uint32_t>(encryptedSize));
+        encryptContent(*keys[i], version, text.data(), text.size(), reinterpret_cast<char*>(payload->putSpace(encryptedSize)), encryptedSize);
+    }
+
+    std::vector<uint8_t> response = co_await sendRequestAsync(605, *payload, version);
     if (response.empty()) {
-        //std::cerr << "No response received (or empty response) from server!\n";
-		throw std::runtime_error("server responded with an error");
-        return;
+        throw std::runtime_error("No response from server for sendMessages.");
     }
-    uint8_t version;
-    uint16_t code;
-    std::vector<uint8_t> payload;
-    std::tie(version, code, payload) = Protocol::parseResponse(response);
-    if (code != 2104) {
-        //std::cerr << "Error: server responded with code " << code << " instead of 2104.\n";
-		throw std::runtime_error("Server responded with code " + std::to_string(code) + " instead of 2104.");
-        return;
+    uint8_t respVersion;
+    uint16_t respCode;
+    std::vector<uint8_t> respPayload;
+    std::tie(respVersion, respCode, respPayload) = Protocol::parseResponse(response);
+    if (respCode != 2105) {
+        throw std::runtime_error("Server responded with code " + std::to_string(respCode) + " for sendMessages.");
     }
+    std::vector<MessageSendStatus> statuses = parseSendStatuses(respPayload, messages.size());
+    size_t stored = std::count_if(statuses.begin(), statuses.end(), [](const MessageSendStatus& status) { return status.stored; });
+    std::cout << stored << " of " << messages.size() << " messages sent successfully.\n";
+    co_return statuses;
+}
 
-    size_t offset = 0;
-    // Process each message from the payload
-    while (true) {
-        // Ensure enough data for the header (16 bytes ID + 4 bytes message ID + 1 byte type + 4 bytes size = 25 bytes)
-        if (offset + 25 > payload.size()) break;
+Task<std::vector<MessageSendStatus>> Client::sendSymmetricKeyRequestsAsync(std::vector<std::string> recipients) {
+    if (recipients.size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::length_error("Too many recipients for one multicast request");
+    }
+
+    // Multicast header (Wire::MulticastHeader), then the recipient IDs in one block; the content is
+    // sent (and stored) only once.
+    using Header = Wire::MulticastHeader;
+    uint8_t messageType = 1; // Request for symmetric key
+    const size_t contentSize = sizeof(KEY_REQUEST_CONTENT) - 1;
+    ByteWriterPool::Lease payload = _writers.acquire(Header::SIZE + recipients.size() * CLIENT_ID_SIZE + contentSize);
+    uint8_t* header = payload->putSpace(Header::SIZE);
+    Header::FromClientId::put(header, _clientId.view());
+    Header::Type::put(header, messageType);
+    Header::RecipientCount::put(header, static_cast<uint16_t>(recipients.size()));
+    Header::ContentSize::put(header, static_cast<uint32_t>(contentSize));
+    for (const std::string& recipient : recipients) {
+        const ClientId* recipientId = _users.findClientId(recipient);
+        if (!recipientId) {
+            throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
+        }
+        payload->putBytes(recipientId->data(), CLIENT_ID_SIZE);
+    }
+    payload->putBytes(KEY_REQUEST_CONTENT, contentSize);
+
+    std::vector<uint8_t> response = co_await sendRequestAsync(606, *payload);
+    if (response.empty()) {
+        throw std::runtime_error("No response from server for the multicast request.");
+    }
+    uint8_t respVersion;
+    uint16_t respCode;
+    std::vector<uint8_t> respPayload;
+    std::tie(respVersion, respCode, respPayload) = Protocol::parseResponse(response);
+    if (respCode != 2106) {
+        throw std::runtime_error("Server responded with code " + std::to_string(respCode) + " for the multicast request.");
+    }
+    std::vector<MessageSendStatus> statuses = parseSendStatuses(respPayload, recipients.size());
+    size_t stored = std::count_if(statuses.begin(), statuses.end(), [](const MessageSendStatus& status) { return status.stored; });
+    std::cout << "Symmetric key request sent to " << stored << " of " << recipients.size() << " recipients.\n";
+    co_return statuses;
+}
 
-        std::string fromClientId(reinterpret_cast<const char*>(&payload[offset]), CLIENT_ID_SIZE);
-        offset += CLIENT_ID_SIZE;
+Task<void> Client::sendFileAsync(std::string recipient, std::string filePath) {
+    std::shared_ptr<AESWrapper> symmetricKey = co_await sessionKeyAsync(recipient);
+    if (!symmetricKey) {
+        throw std::runtime_error("Can't decrypt message '" + recipient + "'");
+    }
+    const ClientId* recipientId = _users.findClientId(recipient);
+    if (!recipientId) {
+        throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
+    }
+    // Copied, because the directory may be reloaded while the transfer is in progress.
+    ClientId toClientId = *recipientId;
+    AESWrapper& aes = *symmetricKey;
+    uint8_t version = peerVersion(toClientId);
+
+    MappedFile file(filePath);
+    uint64_t chunkCount64 = (file.size() + FILE_CHUNK_SIZE - 1) / FILE_CHUNK_SIZE;
+    if (chunkCount64 > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("File is too large to send: " + filePath);
+    }
+    // An empty file is still sent as one (empty) chunk, so the recipient creates it.
+    uint32_t chunkCount = std::max<uint32_t>(1, static_cast<uint32_t>(chunkCount64));
+    std::random_device random;
+    uint32_t transferId = random();
+
+    // Only one chunk is encrypted and in flight at a time; the mapped file is paged in as it is read,
+    // and every chunk is built in the same writer:
+    // [37 bytes message header][12 bytes chunk header][encrypted chunk].
+    ByteWriterPool::Lease payload = _writers.acquire(MESSAGE_HEADER_SIZE + FILE_CHUNK_HEADER_SIZE +
+        encryptedContentSize(version, FILE_CHUNK_SIZE));
+    for (uint32_t index = 0; index < chunkCount; index++) {
+        size_t offset = static_cast<size_t>(index) * FILE_CHUNK_SIZE;
+        size_t length = std::min(FILE_CHUNK_SIZE, file.size() - offset);
+        size_t encryptedSize = encryptedContentSize(version, length);
 
-        uint32_t messageId = 0;
-        for (int i = 0; i < 4; i++) {
-            messageId |= (payload[offset + i] << (8 * i));
+        payload->reset();
+        putMessageHeader(*payload, toClientId, _clientId, FILE_MESSAGE_TYPE,
+            static_cast<uint32_t>(FILE_CHUNK_HEADER_SIZE + encryptedSize));
+        uint8_t* chunkHeader = payload->putSpace(FILE_CHUNK_HEADER_SIZE);
+        Wire::FileChunkHeader::TransferId::put(chunkHeader, transferId);
+        Wire::FileChunkHeader::Index::put(chunkHeader, index);
+        Wire::FileChunkHeader::Count::put(chunkHeader, chunkCount);
+        encryptContent(aes, version, file.data() + offset, length, reinterpret_cast<char*>(payload->putSpace(encryptedSize)), encryptedSize);
+        std::vector<uint8_t> response = co_await sendRequestAsync(603, *payload, version);
+        if (response.empty()) {
+            throw std::runtime_error("No response from server for sendFile.");
         }
-        offset += 4;
+        uint8_t respVersion;
+        uint16_t respCode;
+        std::vector<uint8_t> respPayload;
+        std::tie(respVersion, respCode, respPayload) = Protocol::parseResponse(response);
+        if (respCode != 2103) {
+            throw std::runtime_error("Server responded with code " + std::to_string(respCode) + " for chunk " +
+                std::to_string(index) + " of the file.");
+        }
+    }
+    std::cout << "File sent successfully to '" << recipient << "' (" << file.size() << " bytes in " << chunkCount << " chunks).\n";
+}
 
-        uint8_t messageType = payload[offset];
-        offset += 1;
+std::string Client::receiveFileChunk(const ClientId& fromClientId, std::string_view content, const DecryptedMessage& chunk) {
+    const uint8_t* chunkHeader = reinterpret_cast<const uint8_t*>(content.data());
+    uint32_t transferId = Wire::FileChunkHeader::TransferId::get(chunkHeader);
+    uint32_t index = Wire::FileChunkHeader::Index::get(chunkHeader);
+    uint32_t chunkCount = Wire::FileChunkHeader::Count::get(chunkHeader);
 
-        uint32_t messageSize = 0;
-        for (int i = 0; i < 4; i++) {
-            messageSize |= (payload[offset + i] << (8 * i));
+    // The first chunk creates the file; later chunks (possibly from a later fetch) append to it.
+    TransferKey key{ fromClientId, transferId };
+    auto fileIt = _incomingFiles.find(key);
+    if (index == 0) {
+        std::string fileName = "MessageU_" + Codec::hexEncode(fromClientId.view()) + "_" + std::to_string(transferId);
+        std::string path = (std::filesystem::temp_directory_path() / fileName).string();
+        fileIt = _incomingFiles.insert_or_assign(key, IncomingFile{ std::ofstream(path, std::ios::binary | std::ios::trunc), path, 0, chunkCount }).first;
+        if (!fileIt->second.sink.is_open()) {
+            _incomingFiles.erase(fileIt);
+            return "can't create file " + path;
         }
-        offset += 4;
+    }
+    if (fileIt == _incomingFiles.end() || index != fileIt->second.nextChunk || chunkCount != fileIt->second.chunkCount) {
+        if (fileIt != _incomingFiles.end()) {
+            _incomingFiles.erase(fileIt);
+        }
+        return "file chunk out of order, transfer dropped";
+    }
+
+    IncomingFile& incoming = fileIt->second;
+    if (chunk.chunkRejected) {
+        _incomingFiles.erase(fileIt);
+        return "can't decrypt file chunk, transfer dropped";
+    }
+    incoming.sink.write(chunk.text.data(), chunk.text.size());
+    incoming.nextChunk++;
+    if (incoming.nextChunk < incoming.chunkCount) {
+        return "file chunk " + std::to_string(incoming.nextChunk) + " of " + std::to_string(incoming.chunkCount) + " received";
+    }
+    std::string path = incoming.path;
+    _incomingFiles.erase(fileIt);
+    return "file received: " + path;
+}
 
-        if (offset + messageSize > payload.size()) {
-            //std::cerr << "Error: message size exceeds payload. Possibly corrupted data.\n";
-			throw std::runtime_error("Message size exceeds payload. Possibly corrupted data.");
+Task<Client::MessagePage> Client::fetchPageAsync(uint32_t ackMessageId, uint32_t afterMessageId) {
+    using Request = Wire::FetchPageRequest;
+    ByteWriterPool::Lease request = _writers.acquire(Request::SIZE);
+    uint8_t* fields = request->putSpace(Request::SIZE);
+    Request::AckMessageId::put(fields, ackMessageId);
+    Request::AfterMessageId::put(fields, afterMessageId);
+    Request::MaxCount::put(fields, _fetchPageMaxCount);
+    Request::MaxBytes::put(fields, _fetchPageMaxBytes);
+    std::vector<uint8_t> response = co_await sendRequestAsync(607, *request);
+    if (response.empty()) {
+        throw std::runtime_error("server responded with an error");
+    }
+    uint8_t version;
+    uint16_t code;
+    MessagePage page;
+    std::tie(version, code, page.payload) = Protocol::parseResponse(response);
+    if (code != 2107 || page.payload.empty()) {
+        throw std::runtime_error("Server responded with code " + std::to_string(code) + " instead of 2107.");
+    }
+    page.hasMore = (page.payload[0] != 0);
+    page.records = MessageRecords(std::span<const uint8_t>(page.payload).subspan(1), version);
+    if (page.hasMore && page.records.empty()) {
+        throw std::runtime_error("Server announced more messages but returned an empty page.");
+    }
+    co_return page;
+}
+
+Client::DecryptedMessage Client::decryptMessage(const MessageView& message, std::shared_ptr<AESWrapper>& senderKey,
+    RSAPrivateWrapper* privateKey) {
+    DecryptedMessage decrypted;
+    switch (message.type) {
+    case 1:
+        decrypted.text = "Request for symmetric key";
+        break;
+    case 2:
+        try {
+            if (privateKey == nullptr) {
+                throw std::runtime_error("No private key available.");
+            }
+            std::string decryptedKey = privateKey->decrypt(message.content.data(), static_cast<unsigned int>(message.content.size()));
+            senderKey = std::make_shared<AESWrapper>(
+                reinterpret_cast<const unsigned char*>(decryptedKey.data()), static_cast<unsigned int>(decryptedKey.size()));
+            decrypted.receivedKey = senderKey;
+            decrypted.text = "symmetric key received";
+        }
+        catch (...) {
+            decrypted.text = "failed to decrypt symmetric key";
+        }
+        break;
+    case 3:
+        if (!senderKey) {
+            decrypted.text = "can't decrypt message (no symmetric key)";
+            break;
+        }
+        try {
+            decrypted.text = decryptContent(*senderKey, message.version, message.content);
+        }
+        catch (...) {
+            // A wrong or stale key, or a segment that fails to authenticate, rejects only this message.
+            decrypted.text = "can't decrypt message";
+        }
+        break;
+    case FILE_MESSAGE_TYPE:
+        if (!senderKey) {
+            decrypted.text = "can't decrypt file (no symmetric key)";
             break;
         }
-        std::string content(reinterpret_cast<const char*>(&payload[offset]), messageSize);
-        offset += messageSize;
+        if (message.content.size() < FILE_CHUNK_HEADER_SIZE) {
+            decrypted.text = "malformed file chunk";
+            break;
+        }
+        // The chunk is written to its file when it is displayed, in order with the other chunks.
+        decrypted.fileChunk = true;
+        try {
+            decrypted.text = decryptContent(*senderKey, message.version, message.content.substr(FILE_CHUNK_HEADER_SIZE));
+        }
+        catch (...) {
+            decrypted.chunkRejected = true;
+        }
+        break;
+    default:
+        decrypted.text = "[Unknown message type]";
+        break;
+    }
+    return decrypted;
+}
 
-        std::string fromUserName = "Unknown";
-        // Find the sender's username using the userMap.
-        for (auto& kv : userMap) {
-            if (kv.second == fromClientId) {
-                fromUserName = kv.first;
-                break;
-            }
+Task<void> Client::fetchMessagesAsync() {
+    uint32_t processed = 0;    // ID of the last message displayed
+    uint32_t acknowledged = 0; // ID up to which the server has deleted the displayed messages
+    MessagePage page = co_await fetchPageAsync(0, 0);
+    while (true) {
+        // Request the next page before decrypting this one, so the round trip overlaps the decryption.
+        std::optional<Task<MessagePage>> next;
+        uint32_t ackInFlight = processed;
+        if (page.hasMore) {
+            next.emplace(fetchPageAsync(processed, page.records.back().messageId));
+            next->start();
         }
 
-        std::string displayContent;
-        switch (messageType) {
-        case 1:
-            displayContent = "Request for symmetric key";
-            break;
-        case 2: {
-            try {
-                std::string decryptedKey = _rsaPrivate.decrypt(content);
-                AESWrapper aes((unsigned char*)decryptedKey.data(), decryptedKey.size());
-                _symmetricKeys[fromUserName] = aes;
-                displayContent = "symmetric key received";
+        std::exception_ptr error;
+        bool peerVersionsChanged = false;
+        try {
+            // Decrypt the page on the worker pool, one strand per sender, each starting from the
+            // sender's current key. The strands only see the page and their own key; the client's
+            // state is updated here, as each message is displayed.
+            std::vector<MessageView> messages(page.records.begin(), page.records.end());
+            std::vector<std::string> senders;
+            senders.reserve(messages.size());
+            std::unordered_map<ClientId, std::shared_ptr<AESWrapper>> strandKeys;
+            RSAPrivateWrapper* rsa = nullptr;
+            for (const MessageView& message : messages) {
+                std::string_view knownName = _users.findUserName(message.fromClientId);
+                senders.push_back(knownName.empty() ? "Unknown" : std::string(knownName));
+                if (message.type == 2 && rsa == nullptr) {
+                    try {
+                        rsa = &privateKey();
+                    }
+                    catch (...) {
+                    }
+                }
             }
-            catch (...) {
-                displayContent = "failed to decrypt symmetric key";
+            OrderedStrands<DecryptedMessage, ClientId> decryption(WorkerPool::shared());
+            for (size_t i = 0; i < messages.size(); i++) {
+                auto strand = strandKeys.try_emplace(messages[i].fromClientId);
+                if (strand.second) {
+                    auto symIt = _symmetricKeys.find(messages[i].fromClientId);
+                    if (symIt != _symmetricKeys.end()) {
+                        strand.first->second = symIt->second;
+                    }
+                    else if (_agreementKey && !_users.findUserName(messages[i].fromClientId).empty()) {
+                        // The key with an X25519 sender is agreed on here; this may fetch the sender's public key.
+                        try {
+                            strand.first->second = co_await sessionKeyAsync(senders[i]);
+                        }
+                        catch (const std::runtime_error&) {
+                            // The sender's messages are shown as undecryptable.
+                        }
+                    }
+                }
+                std::shared_ptr<AESWrapper>& senderKey = strand.first->second;
+                const MessageView& message = messages[i];
+                decryption.add(message.fromClientId, [&message, &senderKey, rsa]() { return decryptMessage(message, senderKey, rsa); });
             }
-            break;
-        }
-        case 3: {
-            auto it = _symmetricKeys.find(fromUserName);
-            if (it == _symmetricKeys.end()) {
-                displayContent = "can't decrypt message (no symmetric key)";
+            decryption.start();
+
+            for (size_t i = 0; i < messages.size(); i++) {
+                const MessageView& message = messages[i];
+                const std::string& fromUserName = senders[i];
+                DecryptedMessage decrypted = decryption.take(i);
+                if (!_users.findUserName(message.fromClientId).empty()) {
+                    uint8_t& knownVersion = _peerVersions[message.fromClientId];
+                    peerVersionsChanged |= (knownVersion != message.version);
+                    knownVersion = message.version;
+                }
+                if (decrypted.receivedKey) {
+                    _symmetricKeys[message.fromClientId] = std::move(decrypted.receivedKey);
+                }
+                std::string displayContent = decrypted.fileChunk
+                    ? receiveFileChunk(message.fromClientId, message.content, decrypted) : std::move(decrypted.text);
+                std::cout << "From: " << fromUserName << "\n"
+                    << "Content:\n" << displayContent << "\n"
+                    << "-----<EOM>-----\n\n";
+                processed = message.messageId;
+
+                if (next) {
+                    // Let the loop move the next page along between messages.
+                    co_await yieldTo(_loop);
+                }
             }
-            else {
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        if (peerVersionsChanged) {
+            savePeerVersions();
+        }
+        if (error) {
+            // The request in flight has handlers registered in the loop, so it must finish before it is destroyed.
+            if (next) {
                 try {
-                    std::string plainText = it->second.decrypt(content.c_str(), content.size());
-                    displayContent = plainText;
+                    co_await std::move(*next);
+                    acknowledged = ackInFlight;
+                }
+                catch (...) {
                 }
-                catch (const CryptoPP::Exception& e) {
-                    //std::cerr << "Decryption error occurred." << std::endl;
-					throw std::runtime_error(e.what());
-                    displayContent = "can't decrypt message";
+            }
+            // Acknowledge the messages displayed before the error, so the next fetch starts after them
+            // instead of showing them (and running into the same error) again. The messages this
+            // request returns stay on the server.
+            if (acknowledged != processed) {
+                try {
+                    co_await fetchPageAsync(processed, processed);
                 }
                 catch (...) {
-                    displayContent = "can't decrypt message";
                 }
             }
-            break;
+            std::rethrow_exception(error);
         }
 
-        default:
-            displayContent = "[Unknown message type]";
+        if (next) {
+            page = co_await std::move(*next);
+            acknowledged = ackInFlight;
+        }
+        else if (acknowledged != processed) {
+            // Acknowledge the last page; this also picks up messages that arrived in the meantime.
+            page = co_await fetchPageAsync(processed, processed);
+            acknowledged = processed;
+        }
+        else {
             break;
         }
-
-        std::cout << "From: " << fromUserName << "\n"
-            << "Content:\n" << displayContent << "\n"
-            << "-----<EOM>-----\n\n";
     }
 }
 
+// -----------------------------
+// Blocking API: each call runs the matching coroutine to completion on the client's event loop.
+// -----------------------------
+bool Client::registerClient(const std::string& username) {
+    return syncWait(_loop, registerClientAsync(username));
+}
+
+void Client::requestClientsList() {
+    syncWait(_loop, requestClientsListAsync());
+}
+
+std::string Client::getPublicKey(const std::string& userName) {
+    return syncWait(_loop, getPublicKeyAsync(userName));
+}
+
+void Client::sendSymmetricKey(const std::string& recipient, const std::string& publicKey) {
+    syncWait(_loop, sendSymmetricKeyAsync(recipient, publicKey));
+}
+
+void Client::sendSymmetricKey(const std::string& recipient) {
+    syncWait(_loop, sendSymmetricKeyAsync(recipient));
+}
+
+void Client::sendMessage(const std::string& recipient, const std::string& message) {
+    syncWait(_loop, sendMessageAsync(recipient, message));
+}
+
+std::vector<MessageSendStatus> Client::sendMessages(const std::vector<OutgoingMessage>& messages) {
+    return syncWait(_loop, sendMessagesAsync(messages));
+}
+
+std::vector<MessageSendStatus> Client::sendSymmetricKeyRequests(const std::vector<std::string>& recipients) {
+    return syncWait(_loop, sendSymmetricKeyRequestsAsync(recipients));
+}
+
+void Client::sendFile(const std::string& recipient, const std::string& filePath) {
+    syncWait(_loop, sendFileAsync(recipient, filePath));
+}
+
+void Client::fetchMessages() {
+    syncWait(_loop, fetchMessagesAsync());
+}
+
+void Client::sendSymmetricKeyRequest(const std::string& recipient) {
+    syncWait(_loop, sendSymmetricKeyRequestAsync(recipient));
+}
+
 std::vector<uint8_t> Client::sendRequestAndReceiveResponse(uint16_t requestCode, const std::vector<uint8_t>& payload) {
-    SocketWrapper socketWrapper(_serverIp, _serverPort);
-    if (!socketWrapper.isValid()) {
-        return {};
+    return syncWait(_loop, sendRequestAsync(requestCode, payload));
+}
+
+std::vector<uint8_t> Client::sendRequestAndReceiveResponse(uint16_t requestCode, std::initializer_list<ConstBuffer> payloadParts) {
+    return syncWait(_loop, sendRequestAsync(requestCode, std::span<const ConstBuffer>(payloadParts.begin(), payloadParts.size())));
+}
+
+Task<std::vector<uint8_t>> Client::sendRequestAsync(uint16_t requestCode, const std::vector<uint8_t>& payload, uint8_t version) {
+    const ConstBuffer part = { payload.data(), payload.size() };
+    co_return co_await sendRequestAsync(requestCode, std::span<const ConstBuffer>(&part, 1), version);
+}
+
+Task<std::vector<uint8_t>> Client::sendRequestAsync(uint16_t requestCode, const ByteWriter& payload, uint8_t version) {
+    const ConstBuffer part = { payload.data(), payload.size() };
+    co_return co_await sendRequestAsync(requestCode, std::span<const ConstBuffer>(&part, 1), version);
+}
+
+Task<std::vector<uint8_t>> Client::sendRequestAsync(uint16_t requestCode, std::span<const ConstBuffer> payloadParts, uint8_t version) {
+    if (payloadParts.size() >= SocketWrapper::MAX_SEND_BUFFERS) {
+        throw std::length_error("Too many payload parts for one request");
     }
-    std::vector<uint8_t> request = Protocol::createRequest(_clientId, 1, requestCode, payload);
-    if (!socketWrapper.sendAll(request)) {
-        return {};
+
+    // The request header lives in the coroutine frame; the payload parts are sent from where they live.
+    size_t payloadSize = 0;
+    for (const ConstBuffer& part : payloadParts) {
+        payloadSize += part.size;
+    }
+    auto header = Protocol::createRequestHeader(_clientId, version, requestCode, static_cast<uint32_t>(payloadSize));
+    ConstBuffer buffers[SocketWrapper::MAX_SEND_BUFFERS];
+    size_t count = 0;
+    buffers[count++] = { header.data(), header.size() };
+    for (const ConstBuffer& part : payloadParts) {
+        buffers[count++] = part;
+    }
+
+    // A pooled connection may have been closed by the server while idle. When it turns out closed
+    // before any byte of the response arrived, a request that is safe to repeat is sent once more,
+    // on a fresh connection. Anything else is surfaced: the server may have processed the request
+    // (e.g. stored a message) before the connection went down.
+    // Concurrent requests never share a socket: each one takes an idle socket or connects its own.
+    for (int attempt = 0; ; attempt++) {
+        std::unique_ptr<SocketWrapper> connection = (attempt == 0) ? _pool->tryAcquireIdle() : nullptr;
+        bool pooled = (connection != nullptr);
+        bool retryable = pooled && isRepeatable(requestCode);
+        if (!connection) {
+            connection = _pool->connect();
+        }
+        try {
+            // A pooled socket may still be completing the connect started by the warm-up.
+            co_await asyncConnect(_loop, *connection);
+        }
+        catch (const std::runtime_error&) {
+            // Nothing was sent yet, so any request can go out on a fresh connection.
+            if (!pooled) {
+                throw;
+            }
+            continue;
+        }
+        try {
+            co_await asyncSend(_loop, *connection, buffers, count);
+        }
+        catch (const std::runtime_error&) {
+            if (!retryable) {
+                throw;
+            }
+            continue;
+        }
+        std::vector<uint8_t> response = co_await asyncReceiveFrame(_loop, *connection, _maxFrameSize);
+        if (!response.empty()) {
+            if (_persistentConnection) {
+                _pool->release(std::move(connection));
+            }
+            co_return response;
+        }
+        if (!retryable) {
+            co_return std::vector<uint8_t>{};
+        }
     }
-    return socketWrapper.receiveAll();
 }
 
-void Client::updateUserMap() {
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(601, {});
-    if (response.empty()) {
-        //std::cerr << "Failed to load clients list automatically.\n";
-		throw std::runtime_error("Failed to load clients list automatically.");
+void Client::setPersistentConnection(bool enabled) {
+    _persistentConnection = enabled;
+    if (!enabled) {
+        _pool->clear();
+    }
+}
+
+void Client::setMaxFrameSize(size_t maxFrameSize) {
+    _maxFrameSize = maxFrameSize;
+}
+
+void Client::setFetchPageLimits(uint32_t maxCount, uint32_t maxBytes) {
+    if (maxCount == 0) {
+        throw std::invalid_argument("A fetched page must hold at least one message");
+    }
+    _fetchPageMaxCount = maxCount;
+    _fetchPageMaxBytes = maxBytes;
+}
+
+EventLoop& Client::eventLoop() {
+    return _loop;
+}
+
+void Client::savePublicKeyCache() {
+    try {
+        _publicKeys.save(getPathInExeDirectory(PUBLIC_KEY_CACHE_FILE));
+    }
+    catch (const std::runtime_error& e) {
+        // The cache only saves a key request on the next start.
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void Client::loadPeerVersions() {
+    // [4 bytes magic][4 bytes peer count], then per peer [16 bytes client ID][1 byte version].
+    std::ifstream file(getPathInExeDirectory(PEER_VERSION_CACHE_FILE), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const size_t headerSize = sizeof(PEER_VERSION_CACHE_MAGIC) + 4;
+    const size_t recordSize = CLIENT_ID_SIZE + 1;
+    if (contents.size() < headerSize || std::memcmp(contents.data(), PEER_VERSION_CACHE_MAGIC, sizeof(PEER_VERSION_CACHE_MAGIC)) != 0) {
         return;
     }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(contents.data());
+    size_t count = readUint32(data + sizeof(PEER_VERSION_CACHE_MAGIC));
+    if ((contents.size() - headerSize) / recordSize < count) {
+        return; // A damaged file only costs the versions; they are learned again from the next messages.
+    }
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* record = data + headerSize + i * recordSize;
+        _peerVersions[ClientId(record)] = record[CLIENT_ID_SIZE];
+    }
+}
+
+void Client::savePeerVersions() {
+    ByteWriter contents;
+    contents.putBytes(PEER_VERSION_CACHE_MAGIC, sizeof(PEER_VERSION_CACHE_MAGIC)).putUint32(static_cast<uint32_t>(_peerVersions.size()));
+    for (const auto& peer : _peerVersions) {
+        contents.putBytes(peer.first.view()).putUint8(peer.second);
+    }
+    std::string path = getPathInExeDirectory(PEER_VERSION_CACHE_FILE);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(contents.data()), contents.size())) {
+        // Like the other caches, a failure only loses what the next start would have known.
+        std::cerr << "Unable to write peer version cache: " << path << std::endl;
+    }
+}
+
+Task<void> Client::syncDirectoryAsync() {
+    ByteWriterPool::Lease request = _writers.acquire(Wire::DirectorySyncRequest::SIZE);
+    Wire::DirectorySyncRequest::Generation::put(request->putSpace(Wire::DirectorySyncRequest::SIZE), _users.generation());
+    std::vector<uint8_t> response = co_await sendRequestAsync(608, *request);
+    if (response.empty()) {
+        throw std::runtime_error("Failed to load clients list automatically.");
+    }
     uint8_t version;
     uint16_t code;
     std::vector<uint8_t> payload;
     std::tie(version, code, payload) = Protocol::parseResponse(response);
-    if (code != 2101) {
-        //std::cerr << "Error: server responded with code " << code << "\n";
-		throw std::runtime_error("Server responded with code " + std::to_string(code));
-        return;
+    using Header = Wire::DirectorySyncHeader;
+    if (code != 2108 || payload.size() < Header::SIZE) {
+        throw std::runtime_error("Server responded with code " + std::to_string(code));
     }
-    const size_t RECORD_SIZE = CLIENT_ID_SIZE + USERNAME_SIZE;
-    size_t count = payload.size() / RECORD_SIZE;
-    userMap.clear();
-    for (size_t i = 0; i < count; i++) {
-        size_t offset = i * RECORD_SIZE;
-        const uint8_t* recPtr = payload.data() + offset;
-        std::string idBin(reinterpret_cast<const char*>(recPtr), CLIENT_ID_SIZE);
-        std::string userName(reinterpret_cast<const char*>(recPtr + CLIENT_ID_SIZE), USERNAME_SIZE);
-        userName = std::string(userName.c_str());
-        userName = trim(userName);
-        userMap[userName] = idBin;
+    uint32_t generation = Header::Generation::get(payload.data());
+    bool full = (Header::Full::get(payload.data()) != 0);
+    if (!full && generation == _users.generation()) {
+        co_return; // Nobody registered since the last sync.
+    }
+
+    // Each record is [16 bytes client ID][255 bytes username]; the directory trims the names.
+    std::span<const uint8_t> records = std::span<const uint8_t>(payload).subspan(Header::SIZE);
+    size_t firstNew = full ? 0 : _users.size();
+    if (full) {
+        // The server's directory was replaced (or is new to this client), so cached keys may be stale too.
+        _users.load(records);
+        _publicKeys.clear();
+        savePublicKeyCache();
+    }
+    else {
+        _users.append(records);
+    }
+    _users.setGeneration(generation);
+    try {
+        _users.saveCache(getPathInExeDirectory(DIRECTORY_CACHE_FILE), firstNew);
+    }
+    catch (const std::runtime_error& e) {
+        // The cache only saves a download on the next start; the directory itself is up to date.
+        std::cerr << e.what() << std::endl;
     }
 }
 
-void Client::sendSymmetricKeyRequest(const std::string& recipient) {
-    auto it = userMap.find(recipient);
-    if (it == userMap.end()) {
+Task<void> Client::sendSymmetricKeyRequestAsync(std::string recipient) {
+    const ClientId* found = _users.findClientId(recipient);
+    if (!found) {
         //std::cerr << "Error: Recipient '" << recipient << "' not found in user list.\n";
 		throw std::runtime_error("Recipient '" + recipient + "' not found in user list.");
-        return;
+        co_return;
     }
-    std::string toClientId = adjustToSize(it->second, CLIENT_ID_SIZE);
-    std::string fromClientId = adjustToSize(_clientId, CLIENT_ID_SIZE);
+    ClientId toClientId = *found;
 
     uint8_t messageType = 1; // Request for symmetric key
-    std::string requestContent = "Request for symetric key";
-    uint32_t contentSize = static_cast<uint32_t>(requestContent.size());
-
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), toClientId.begin(), toClientId.end());
-    payload.insert(payload.end(), fromClientId.begin(), fromClientId.end());
-    payload.push_back(messageType);
-    for (int i = 0; i < 4; i++) {
-        payload.push_back((contentSize >> (8 * i)) & 0xFF);
-    }
-    payload.insert(payload.end(), requestContent.begin(), requestContent.end());
+    const char* requestContent = KEY_REQUEST_CONTENT;
+    const size_t contentSize = sizeof(KEY_REQUEST_CONTENT) - 1;
 
-    std::vector<uint8_t> response = sendRequestAndReceiveResponse(603, payload);
+    ByteWriterPool::Lease payload = _writers.acquire(MESSAGE_HEADER_SIZE + contentSize);
+    putMessageHeader(*payload, toClientId, _clientId, messageType, static_cast<uint32_t>(contentSize));
+    payload->putBytes(requestContent, contentSize);
+    std::vector<uint8_t> response = co_await sendRequestAsync(603, *payload);
     if (response.empty()) {
 		throw std::runtime_error("server responded with an error.");
         //std::cerr << "Error: No response received from server.\n";
-        return;
+        co_return;
     }
     uint8_t respVersion;
     uint16_t respCode;
@@ -545,7 +1276,7 @@ void Client::sendSymmetricKeyRequest(const std::string& recipient) {
     catch (const std::exception& e) {
         //std::cerr << "Error parsing response: " << e.what() << "\n";
 		throw std::runtime_error("Error parsing response: " + std::string(e.what()));
-        return;
+        co_return;
     }
     if (respCode != 2103) {
         std::cerr << "Error: Server responded with code " << respCode <<"\n";
@@ -553,7 +1284,7 @@ void Client::sendSymmetricKeyRequest(const std::string& recipient) {
             //std::cerr << "Server message: " << std::string(respPayload.begin(), respPayload.end()) << "\n";
 			throw std::runtime_error("Server message: " + std::string(respPayload.begin(), respPayload.end()));
         }
-        return;
+        co_return;
     }
     std::cout << "Symmetric key request sent successfully to '" << recipient << "'.\n";
 }
\ No newline at end of file
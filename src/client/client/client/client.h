@@ -1,33 +1,74 @@
 ﻿#pragma once
 #include "AESWrapper.h"
-#include "Base64Wrapper.h"
+#include "ByteWriter.h"
+#include "Codec.h"
 #include "RSAWrapper.h"
 #include "protocol.h"
 #include "SocketWrapper.h"
+#include "ConnectionPool.h"
+#include "Task.h"
+#include "MappedFile.h"
+#include "MessageView.h"
+#include "UserDirectory.h"
+#include "PublicKeyCache.h"
+
+
+/**
+ * @brief One text message of a batch sent with Client::sendMessages.
+ */
+struct OutgoingMessage {
+    std::string recipient; ///< Username of the recipient.
+    std::string text;      ///< Plain text; it is encrypted with the recipient's symmetric key.
+};
+
+/**
+ * @brief Outcome of one message of a batch, as reported by the server.
+ */
+struct MessageSendStatus {
+    bool stored;        ///< true if the server stored the message.
+    uint32_t messageId; ///< ID the server assigned to the message (0 if it was not stored).
+};
 
 
 /**
  * @brief The Client class manages the client-side operations of the messaging application.
  *
  * The Client class handles registration, sending and receiving messages, and key exchange
- * with the server. It uses RSA for asymmetric operations and AES for symmetric encryption.
+ * with the server. It uses X25519 key agreement (or, for identities registered with RSA, RSA key
+ * transport) to set up the symmetric keys, and AES for symmetric encryption.
  * It also manages a mapping of user names to client IDs and stores symmetric keys for
  * secure communication.
+ *
+ * Every server operation has an asynchronous form returning a Task (e.g. sendMessageAsync) that
+ * runs on the client's EventLoop, so one thread can keep many requests in flight:
+ * @code
+ *   co_await client.sendMessageAsync("bob", "hi");
+ *   syncWait(client.eventLoop(), whenAll(client.eventLoop(), std::move(tasks)));
+ * @endcode
+ * The blocking methods (registerClient, sendMessage, ...) are thin wrappers that run the
+ * asynchronous form to completion; they must not be called from inside a running task.
  */
 class Client {
 public:
+    static constexpr size_t FILE_CHUNK_SIZE = 64 * 1024; ///< Plain-text bytes per file chunk.
+    static constexpr uint8_t PROTOCOL_VERSION = 2;   ///< Highest protocol version spoken; version 2 contents are AES-GCM sealed.
+
     /**
      * @brief Constructs a new Client object.
      *
      * Initializes the client by reading the server information from a configuration file
-     * and setting up the network (Winsock). It also initializes the RSA private key.
+     * and setting up the network (Winsock on Windows). It starts connecting the connection pool without waiting for the server and
+     * loads the identity (username, client ID and private key) from me.info. An RSA private key is
+     * only parsed when it is first needed. A new client generates an X25519 key pair when it registers.
+     *
+     * @throws std::runtime_error if me.info exists but is malformed.
      */
     Client();
 
     /**
      * @brief Destroys the Client object.
      *
-     * Cleans up resources such as the Winsock library.
+     * Closes the pooled connections and cleans up resources such as the Winsock library on Windows.
      */
     ~Client();
 
@@ -41,6 +82,17 @@ public:
      */
     std::tuple<std::string, unsigned short> readServerInfo();
 
+    /**
+     * @brief Reads the optional connection pool settings from the configuration file.
+     *
+     * The settings are "key=value" lines following the address line in "server.info"
+     * (poolSize, idleTimeout in seconds, healthCheck as 0 or 1). Missing settings keep their defaults.
+     *
+     * @return The connection pool settings.
+     * @throws std::runtime_error if a line is malformed or names an unknown setting.
+     */
+    ConnectionPoolConfig readConnectionPoolConfig();
+
     /**
      * @brief Registers a new client with the server.
      *
@@ -52,22 +104,33 @@ public:
      */
     bool registerClient(const std::string& username);
 
+    /**
+     * @brief Checks whether the client has an identity, loaded from me.info or from a registration.
+     */
+    bool isRegistered() const;
+
+    /**
+     * @brief Returns the username of the registered client (empty if not registered).
+     */
+    const std::string& username() const;
+
     /**
      * @brief Requests the list of registered clients from the server.
      *
-     * Sends a request to the server to retrieve the list of clients. The response is used
-     * to update an internal user map mapping usernames to their unique client IDs.
+     * Brings the internal user directory, which maps usernames to client IDs and back, up to date
+     * by downloading only the users registered since the last sync, and prints every username.
      */
     void requestClientsList();
 
     /**
      * @brief Retrieves the public key of a specified recipient.
      *
-     * Sends a request to the server using the recipient's client ID to get the corresponding
-     * public key. The public key is returned as a Base64-encoded string.
+     * A key already in the public key cache is returned without contacting the server; otherwise
+     * it is requested with the recipient's client ID and cached. The public key is returned in
+     * binary form: 32 bytes for an X25519 key, DER for an RSA key.
      *
      * @param recipient The username of the recipient.
-     * @return The recipient's public key as a Base64-encoded string, or an empty string on failure.
+     * @return The recipient's public key, or an empty string on failure.
      */
     std::string getPublicKey(const std::string& recipient);
 
@@ -79,10 +142,20 @@ public:
      * 1 byte message type, 4 bytes content size, and the encrypted symmetric key as content).
      *
      * @param recipient The username of the recipient.
-     * @param publicKey The recipient's public key (Base64-encoded).
+     * @param publicKey The recipient's public key in binary form, as returned by getPublicKey.
      */
     void sendSymmetricKey(const std::string& recipient, const std::string& publicKey);
 
+    /**
+     * @brief Sends the symmetric key to a specified recipient, using the recipient's cached public key.
+     *
+     * The key is requested from the server (and cached) only if the cache does not hold it yet, so
+     * a key exchange with a known peer needs no extra round trip and no key parsing.
+     *
+     * @param recipient The username of the recipient.
+     */
+    void sendSymmetricKey(const std::string& recipient);
+
     /**
      * @brief Sends a text message to a specified recipient.
      *
@@ -94,11 +167,54 @@ public:
      */
     void sendMessage(const std::string& recipient, const std::string& message);
 
+    /**
+     * @brief Sends several text messages in one request (batch send, request code 605).
+     *
+     * Each message is encrypted with the symmetric key shared with its recipient and encoded as a
+     * 603-style record (37-byte message header followed by the ciphertext). All records go to the
+     * server in a single round trip and are stored in one transaction. Nothing is sent if a
+     * recipient is unknown or has no symmetric key.
+     *
+     * @param messages The messages to send.
+     * @return The server's status for each message, in the order of \p messages.
+     *
+     * @throws std::runtime_error if a message cannot be encrypted or the server rejects the batch.
+     */
+    std::vector<MessageSendStatus> sendMessages(const std::vector<OutgoingMessage>& messages);
+
+    /**
+     * @brief Sends a file to a specified recipient (message type 4).
+     *
+     * The file is memory-mapped and encrypted in chunks of FILE_CHUNK_SIZE bytes with the symmetric
+     * key shared with the recipient. Each chunk goes to the server as its own 603 message, so memory
+     * use stays bounded by the chunk size whatever the size of the file. A chunk's content is
+     * [4 bytes transfer ID][4 bytes chunk index][4 bytes chunk count][encrypted chunk].
+     *
+     * @param recipient The username of the recipient.
+     * @param filePath The path of the file to send.
+     *
+     * @throws std::runtime_error if there is no symmetric key for the recipient, the file cannot be
+     *         read, or the server rejects a chunk.
+     */
+    void sendFile(const std::string& recipient, const std::string& filePath);
+
     /**
      * @brief Fetches waiting messages from the server.
      *
-     * Sends a request to the server to retrieve all pending messages for this client.
-     * The messages are then parsed and displayed in a specified format.
+     * Retrieves all pending messages for this client page by page (see setFetchPageLimits) and
+     * displays them in a specified format. The next page is requested before the current one is
+     * decrypted, and the server deletes a message only once a later request acknowledges that it
+     * has been displayed. The messages of a page are decrypted on the worker pool, one strand per
+     * sender: a sender's messages are decrypted in order (so a symmetric key is in place before the
+     * messages that use it) and different senders in parallel, while the results are displayed in
+     * message ID order. File chunks are written to a file in the temporary directory, whose path is
+     * displayed once the last chunk has arrived.
+     *
+     * A message that can't be decrypted is displayed as such and acknowledged like the others. If
+     * the fetch fails part-way, the messages already displayed are acknowledged before the error is
+     * thrown, so the next fetch continues after them.
+     *
+     * @throws std::runtime_error if a request fails or the server returns a malformed page.
      */
     void fetchMessages();
 
@@ -112,11 +228,83 @@ public:
      */
     void sendSymmetricKeyRequest(const std::string& recipient);
 
+    /**
+     * @brief Asynchronous version of registerClient.
+     */
+    Task<bool> registerClientAsync(std::string username);
+
+    /**
+     * @brief Asynchronous version of requestClientsList.
+     */
+    Task<void> requestClientsListAsync();
+
+    /**
+     * @brief Asynchronous version of getPublicKey.
+     */
+    Task<std::string> getPublicKeyAsync(std::string recipient);
+
+    /**
+     * @brief Asynchronous version of sendSymmetricKey.
+     */
+    Task<void> sendSymmetricKeyAsync(std::string recipient, std::string publicKey);
+
+    /**
+     * @brief Asynchronous version of sendSymmetricKey using the cached public key.
+     */
+    Task<void> sendSymmetricKeyAsync(std::string recipient);
+
+    /**
+     * @brief Asynchronous version of sendMessage.
+     */
+    Task<void> sendMessageAsync(std::string recipient, std::string message);
+
+    /**
+     * @brief Asynchronous version of sendMessages.
+     */
+    Task<std::vector<MessageSendStatus>> sendMessagesAsync(std::vector<OutgoingMessage> messages);
+
+    /**
+     * @brief Asynchronous version of sendFile.
+     */
+    Task<void> sendFileAsync(std::string recipient, std::string filePath);
+
+    /**
+     * @brief Asynchronous version of fetchMessages.
+     */
+    Task<void> fetchMessagesAsync();
+
+    /**
+     * @brief Asynchronous version of sendSymmetricKeyRequest.
+     */
+    Task<void> sendSymmetricKeyRequestAsync(std::string recipient);
+
+    /**
+     * @brief Sends a symmetric key request to several recipients in one multicast request (code 606).
+     *
+     * The request content is sent and stored once on the server; each recipient's mailbox only
+     * refers to it. The multicast payload is [16 bytes sender ID][1 byte message type]
+     * [2 bytes recipient count][4 bytes content size][16 bytes per recipient ID][content].
+     *
+     * @param recipients The usernames of the recipients (at most 65535).
+     * @return The server's status for each recipient, in the order of \p recipients.
+     *
+     * @throws std::runtime_error if a recipient is unknown or the server rejects the request.
+     */
+    std::vector<MessageSendStatus> sendSymmetricKeyRequests(const std::vector<std::string>& recipients);
+
+    /**
+     * @brief Asynchronous version of sendSymmetricKeyRequests.
+     */
+    Task<std::vector<MessageSendStatus>> sendSymmetricKeyRequestsAsync(std::vector<std::string> recipients);
+
     /**
      * @brief Sends a request to the server and receives its response.
      *
      * Constructs a complete protocol message using the current client ID, version, request code,
      * and payload. It then sends the message using a TCP socket and returns the server's response.
+     * In persistent-connection mode the socket is taken from the connection pool and returned to it
+     * afterwards; if the server closed a pooled socket while idle, the request is retried once on a
+     * new connection.
      *
      * @param requestCode The request code as defined by the protocol.
      * @param payload The payload data as a vector of bytes.
@@ -124,17 +312,110 @@ public:
      */
     std::vector<uint8_t> sendRequestAndReceiveResponse(uint16_t requestCode, const std::vector<uint8_t>& payload);
 
+    /**
+     * @brief Sends a request whose payload is made of several parts and receives the response.
+     *
+     * The request header is built separately and sent together with the payload parts in one
+     * scatter-gather send, so the parts (e.g. a message sub-header and a ciphertext) are never
+     * concatenated into one buffer.
+     *
+     * @param requestCode The request code as defined by the protocol.
+     * @param payloadParts The parts of the payload, in wire order.
+     * @return A vector of bytes containing the server's response.
+     */
+    std::vector<uint8_t> sendRequestAndReceiveResponse(uint16_t requestCode, std::initializer_list<ConstBuffer> payloadParts);
+
+    /**
+     * @brief Asynchronous version of sendRequestAndReceiveResponse.
+     *
+     * The request runs on its own connection (an idle pooled one or a new one connected without
+     * blocking), so any number of requests can be in flight at once. The payload must stay alive
+     * until the task completes, which is always the case when the task is awaited directly.
+     *
+     * If a reused connection turns out to have been closed before any byte of the response
+     * arrived, a request that is safe to repeat (601, 602, 607, 608) is sent once more on a new
+     * connection. Other requests are not repeated, since the server may already have processed them.
+     *
+     * @param requestCode The request code as defined by the protocol.
+     * @param payload The payload data as a vector of bytes.
+     * @param version The protocol version written in the request header.
+     * @return A task producing the server's response (header and payload), or an empty vector if
+     *         the connection was closed without a response.
+     * @throws std::runtime_error if the connection fails or is closed in the middle of the response.
+     */
+    Task<std::vector<uint8_t>> sendRequestAsync(uint16_t requestCode, const std::vector<uint8_t>& payload,
+        uint8_t version = PROTOCOL_VERSION);
+
+    /**
+     * @brief Sends the payload built in \p payload; it must stay alive (and unchanged) until the task completes.
+     */
+    Task<std::vector<uint8_t>> sendRequestAsync(uint16_t requestCode, const ByteWriter& payload,
+        uint8_t version = PROTOCOL_VERSION);
+
+    /**
+     * @brief Asynchronous version of the multi-part sendRequestAndReceiveResponse.
+     *
+     * @param requestCode The request code as defined by the protocol.
+     * @param payloadParts The parts of the payload, in wire order (none for an empty payload); the parts and
+     *        the array describing them must stay alive until the task completes.
+     * @param version The protocol version written in the request header. The server stores sent
+     *        messages with it, and it tells the recipient how the content is encrypted.
+     * @return A task producing the server's response (header and payload).
+     */
+    Task<std::vector<uint8_t>> sendRequestAsync(uint16_t requestCode, std::span<const ConstBuffer> payloadParts = {},
+        uint8_t version = PROTOCOL_VERSION);
+
+    /**
+     * @brief Enables or disables the persistent-connection (keep-alive) mode.
+     *
+     * When enabled (the default), connections to the server are kept open in the connection pool
+     * and reused for further requests, with responses delimited by their 7-byte header. When
+     * disabled, every request opens and closes its own connection. Disabling the mode closes all
+     * pooled connections.
+     *
+     * @param enabled true to keep one connection open across requests, false otherwise.
+     */
+    void setPersistentConnection(bool enabled);
+
+    /**
+     * @brief Sets the largest response payload the client will accept.
+     *
+     * A response whose header declares a larger payload is rejected before any buffer is allocated
+     * for it, and the connection it arrived on is closed.
+     *
+     * @param maxFrameSize The maximum payload size in bytes.
+     */
+    void setMaxFrameSize(size_t maxFrameSize);
+
+    /**
+     * @brief Sets the size of the pages in which fetchMessages retrieves waiting messages.
+     *
+     * The server always returns at least one message per page, even if that message alone is
+     * larger than \p maxBytes.
+     *
+     * @param maxCount The maximum number of messages per page.
+     * @param maxBytes The maximum total content size per page, in bytes.
+     */
+    void setFetchPageLimits(uint32_t maxCount, uint32_t maxBytes);
+
+    /**
+     * @brief Returns the event loop that drives the asynchronous API.
+     *
+     * Run it (or use syncWait) from the thread that owns the client to make progress on tasks.
+     */
+    EventLoop& eventLoop();
+
 private:
     /**
      * @brief Builds the registration payload for the client.
      *
-     * Constructs a payload consisting of 255 bytes for the username (null-padded) and 160 bytes for the
-     * RSA public key in raw binary format.
+     * Constructs a payload consisting of 255 bytes for the username (null-padded) and the 32-byte
+     * X25519 public key, generating the key pair if the client has none yet.
      *
      * @param username The username of the client.
-     * @return A vector of bytes representing the registration payload.
+     * @param payload Receives the registration payload.
      */
-    std::vector<uint8_t> buildRegistrationPayload(const std::string& username);
+    void buildRegistrationPayload(const std::string& username, ByteWriter& payload);
 
     /**
      * @brief Updates the client ID from the server's response.
@@ -147,11 +428,74 @@ private:
     bool updateClientIdFromResponse(const std::vector<uint8_t>& response);
 
     /**
-     * @brief Updates the local user map by requesting the list of clients from the server.
+     * @brief Brings the local user directory up to date with the server.
+     *
+     * Sends the directory generation the client knows (request 608) and adds the users the server
+     * registered after it, then saves the directory to the cache file next to me.info, which the
+     * constructor loads on the next start. The directory associates usernames with their raw
+     * 16-byte client IDs, in both directions.
+     */
+    Task<void> syncDirectoryAsync();
+
+    /**
+     * @brief Returns the parsed public key of a user, from the cache or else from the server (602).
+     *
+     * @param userName The username of the peer.
+     * @return The peer's public key.
+     */
+    Task<std::shared_ptr<const PeerKey>> peerPublicKeyAsync(std::string userName);
+
+    /**
+     * @brief Generates a new symmetric key, sends it encrypted with \p publicKey and keeps it for the recipient.
+     *
+     * If both this client and the recipient have X25519 keys, the key is agreed on instead and nothing is sent.
+     *
+     * @throws std::runtime_error if the recipient has an X25519 key but this client an RSA one.
+     */
+    Task<void> sendSymmetricKeyWithAsync(std::string recipient, std::shared_ptr<const PeerKey> publicKey);
+
+    /**
+     * @brief Returns the symmetric key shared with a user, agreeing on it first if needed.
+     *
+     * A key that was sent or received is used as is. Otherwise, if both this client and the user have
+     * X25519 keys, the key is derived from the two keys (fetching the user's public key if it is not
+     * cached) and kept for the user.
+     *
+     * @param userName The username of the peer.
+     * @return The key, or null if there is none and it can't be agreed on.
+     */
+    Task<std::shared_ptr<AESWrapper>> sessionKeyAsync(std::string userName);
+
+    /**
+     * @brief Derives the symmetric key shared with an X25519 peer and keeps it for the peer.
+     *
+     * Both sides derive the same key: HKDF over the X25519 secret, salted with the two client IDs
+     * in byte order.
+     *
+     * @throws std::runtime_error if this client has no X25519 key or the peer's key is invalid.
+     */
+    std::shared_ptr<AESWrapper> agreeSessionKey(const ClientId& peerClientId, const PeerKey& peerKey);
+
+    /**
+     * @brief Saves the public key cache next to me.info, reporting (but otherwise ignoring) a failure.
+     */
+    void savePublicKeyCache();
+
+    /**
+     * @brief Loads the username, client ID and Base64 private key from me.info, if the file exists.
+     *
+     * @return true if an identity was loaded.
+     *
+     * @throws std::runtime_error if the file is malformed.
+     */
+    bool loadIdentity();
+
+    /**
+     * @brief Returns the RSA private key, parsing it from me.info on first use.
      *
-     * The user map is used to associate usernames with their raw 16-byte client IDs.
+     * @throws std::runtime_error if the client has no RSA key (it is unregistered or has an X25519 key).
      */
-    void updateUserMap();
+    RSAPrivateWrapper& privateKey();
 
     /**
      * @brief Writes the registration information to a file.
@@ -164,13 +508,129 @@ private:
      */
     void writeRegistrationInfoToFile(const std::string& username, const std::string& fileName);
 
+    /**
+     * @brief One page of waiting messages, as returned by the server.
+     */
+    struct MessagePage {
+        bool hasMore;                 ///< Whether more messages are waiting after this page.
+        std::vector<uint8_t> payload; ///< The response payload; the message records start at offset 1.
+        MessageRecords records;       ///< The validated records, viewing payload (whose buffer moves with it).
+    };
+
+    /**
+     * @brief Requests one page of waiting messages.
+     *
+     * The records of the returned page are validated, so they can be read without further bounds checks.
+     *
+     * @param ackMessageId Messages up to this ID have been displayed and may be deleted by the server.
+     * @param afterMessageId The page starts after the message with this ID.
+     * @return The page.
+     */
+    Task<MessagePage> fetchPageAsync(uint32_t ackMessageId, uint32_t afterMessageId);
+
+    /**
+     * @brief Outcome of decrypting one fetched message on the worker pool.
+     */
+    struct DecryptedMessage {
+        std::string text;                        ///< Text to display, or the plain text of a file chunk (if fileChunk is set).
+        std::shared_ptr<AESWrapper> receivedKey; ///< Symmetric key carried by a type 2 message, installed when it is displayed.
+        bool fileChunk = false;                  ///< Whether the message is a well-formed file chunk that was decrypted (or tried to be).
+        bool chunkRejected = false;              ///< Whether that file chunk failed to decrypt.
+    };
+
+    /**
+     * @brief Decrypts (if needed) one received message. Safe to run on a worker thread.
+     *
+     * Only the arguments are used, none of the client's state: the caller runs the messages of one
+     * sender one after another, with the same senderKey.
+     *
+     * @param message The message, viewed in place in the fetched page.
+     * @param senderKey The sender's symmetric key (null if none); replaced when the message carries a new key.
+     * @param privateKey The client's private key, or null if it is not available.
+     * @return The text to display, or the file chunk to write, and the received key, if any. A
+     *         message that fails to decrypt is returned with a "can't decrypt" text; it never throws
+     *         for one bad message.
+     */
+    static DecryptedMessage decryptMessage(const MessageView& message, std::shared_ptr<AESWrapper>& senderKey,
+        RSAPrivateWrapper* privateKey);
+
+    /**
+     * @brief Writes one decrypted file chunk to the file of its transfer.
+     *
+     * @param fromClientId The ID of the sender.
+     * @param content The chunk content ([transfer ID][chunk index][chunk count][encrypted chunk]).
+     * @param chunk The decrypted chunk.
+     * @return The text to display for the chunk.
+     */
+    std::string receiveFileChunk(const ClientId& fromClientId, std::string_view content, const DecryptedMessage& chunk);
+
+    /**
+     * @brief Returns the protocol version to send text and file contents to a peer with.
+     *
+     * A peer whose key was agreed on (X25519) is always sent version 2 contents. For other peers this
+     * is the version of the peer's latest received message (capped at PROTOCOL_VERSION), so an RSA
+     * peer running an older client can still read what it is sent, or PROTOCOL_VERSION for a peer
+     * that has not sent anything yet: contents are only AES-CBC encrypted for a peer known to need it.
+     */
+    uint8_t peerVersion(const ClientId& peerId) const;
+
+    /**
+     * @brief Loads the peers' protocol versions saved by savePeerVersions; a missing or damaged file loads none.
+     */
+    void loadPeerVersions();
+
+    /**
+     * @brief Saves the peers' protocol versions next to me.info, reporting (but otherwise ignoring) a failure.
+     *
+     * The file is [4 bytes magic][4 bytes peer count], then per peer [16 bytes client ID][1 byte version].
+     */
+    void savePeerVersions();
+
+    /**
+     * @brief A file being received chunk by chunk.
+     */
+    struct IncomingFile {
+        std::ofstream sink;   ///< The file the decrypted chunks are written to.
+        std::string path;     ///< Path of that file.
+        uint32_t nextChunk;   ///< Index of the next expected chunk.
+        uint32_t chunkCount;  ///< Total number of chunks of the transfer.
+    };
+
+    /**
+     * @brief Identifies a file transfer: the sender and the transfer ID it chose.
+     */
+    struct TransferKey {
+        ClientId sender;
+        uint32_t transferId;
+
+        bool operator==(const TransferKey& other) const { return transferId == other.transferId && sender == other.sender; }
+    };
+
+    struct TransferKeyHash {
+        size_t operator()(const TransferKey& key) const noexcept { return static_cast<size_t>(key.sender.hash() ^ key.transferId); }
+    };
+
     // Private member variables:
 
     std::tuple<std::string, unsigned short> serverInfo; ///< Tuple holding the server IP and port.
     std::string _serverIp;        ///< Server IP address.
     unsigned short _serverPort;              ///< Server port number.
-    std::string _clientId;        ///< Client's unique ID (16 raw bytes).
-    RSAPrivateWrapper _rsaPrivate;///< RSA private key wrapper for this client.
-    std::unordered_map<std::string, AESWrapper> _symmetricKeys; ///< Map of recipient usernames to symmetric keys.
-    std::unordered_map<std::string, std::string> userMap; ///< Map of usernames to their raw 16-byte client IDs.
+    ClientId _clientId;           ///< Client's unique ID; all zeros until registered.
+    std::string _username;        ///< Username of the registered client.
+    std::unique_ptr<RSAPrivateWrapper> _rsaPrivate; ///< RSA private key; null until first needed.
+    std::string _rsaPrivateKeyBytes; ///< RSA private key (DER) loaded from me.info, parsed on first use.
+    std::unique_ptr<X25519Wrapper> _agreementKey; ///< X25519 private key; null for an RSA identity.
+    std::unordered_map<ClientId, std::shared_ptr<AESWrapper>> _symmetricKeys; ///< Map of peer client IDs to symmetric keys; each keeps its cipher contexts set up between messages.
+    UserDirectory _users;         ///< Registered users, by username and by client ID.
+    PublicKeyCache _publicKeys;   ///< Parsed public keys of the peers, by client ID.
+    bool _persistentConnection;   ///< Whether one connection is reused across requests.
+    std::unique_ptr<ConnectionPool> _pool; ///< Pool of pre-connected sockets to the server.
+    size_t _maxFrameSize;         ///< Largest accepted response payload, in bytes.
+    uint32_t _fetchPageMaxCount;  ///< Maximum number of messages per fetched page.
+    uint32_t _fetchPageMaxBytes;  ///< Maximum content size per fetched page, in bytes.
+    ByteWriterPool _writers;      ///< Reusable buffers the request payloads are built in.
+    EventLoop _loop;              ///< Event loop that drives the asynchronous requests.
+    std::unordered_map<TransferKey, IncomingFile, TransferKeyHash> _incomingFiles; ///< Unfinished file transfers, by sender ID and transfer ID.
+    std::unordered_map<ClientId, uint8_t> _peerVersions; ///< Protocol version of each peer's latest message, by client ID; saved across runs.
+    std::unordered_set<ClientId> _agreedPeers; ///< Peers whose symmetric key was agreed on with X25519.
 };
\ No newline at end of file
@@ -1,7 +1,6 @@
 ﻿#define NOMINMAX
 #include "utils.h"
 #include "client.h"
-#include "Base64Wrapper.h"
 
 
 /**
@@ -18,6 +17,7 @@ static void displayMenu() {
         << "150) Send a text message\n"
         << "151) Send a request for symmetric key\n"
         << "152) Send your symmetric key\n"
+        << "153) Send a file\n"
         << "0) Exit client\n"
         << "? \n";
 }
@@ -34,8 +34,9 @@ static void displayMenu() {
 int main() {
     try{
     Client client;
-    bool registered = false;
-    std::string username;
+    // A client whose identity was loaded from me.info is already registered.
+    bool registered = client.isRegistered();
+    std::string username = client.username();
 
     while (true) {
         displayMenu();
@@ -121,13 +122,19 @@ int main() {
             std::cout << "Enter recipient username: ";
             std::string recipient;
             std::getline(std::cin, recipient);
-            // Automatically obtain the recipient's public key
-            std::string recipientPubKey = client.getPublicKey(recipient);
-            if (recipientPubKey.empty()) {
-                std::cout << "Public key for recipient not found. Please try again.\n";
-                break;
-            }
-            client.sendSymmetricKey(recipient, recipientPubKey);
+            // The recipient's public key comes from the key cache, or is requested automatically.
+            client.sendSymmetricKey(recipient);
+            break;
+        }
+        case 153: {
+            // Send a file to a recipient, encrypted chunk by chunk.
+            std::cout << "Enter recipient username: ";
+            std::string recipient;
+            std::getline(std::cin, recipient);
+            std::cout << "Enter the file path: ";
+            std::string filePath;
+            std::getline(std::cin, filePath);
+            client.sendFile(recipient, filePath);
             break;
         }
         default:
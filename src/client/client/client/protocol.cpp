@@ -1,72 +1,57 @@
 ﻿#include "utils.h"
 #include "protocol.h"
+#include "ByteWriter.h"
 
 
-std::vector<uint8_t> Protocol::createRequest(const std::string& clientId, uint8_t version, uint16_t code, const std::vector<uint8_t>& payload) {
-    std::vector<uint8_t> request;
+std::vector<uint8_t> Protocol::createRequest(const ClientId& clientId, uint8_t version, uint16_t code, const std::vector<uint8_t>& payload) {
+    std::array<uint8_t, REQUEST_HEADER_SIZE> header = createRequestHeader(clientId, version, code, static_cast<uint32_t>(payload.size()));
 
-    // Append the adjusted 16-byte Client ID.
-    std::string cid = adjustToSize(clientId, 16);
-    request.insert(request.end(), cid.begin(), cid.end());
+    ByteWriter request(header.size() + payload.size());
+    request.putBytes(header.data(), header.size());
 
-    // Append version (1 byte).
-    request.push_back(version);
+    // Append the actual payload.
+    request.putBytes(payload.data(), payload.size());
 
-    // Append Request Code (2 bytes, little-endian).
-    request.push_back(code & 0xFF);
-    request.push_back((code >> 8) & 0xFF);
+    return request.take();
+}
 
-    // Append Payload Size (4 bytes, little-endian).
-    uint32_t payloadSize = static_cast<uint32_t>(payload.size());
-    for (int i = 0; i < 4; i++) {
-        request.push_back((payloadSize >> (8 * i)) & 0xFF);
-    }
+std::array<uint8_t, Protocol::REQUEST_HEADER_SIZE> Protocol::createRequestHeader(const ClientId& clientId, uint8_t version, uint16_t code, uint32_t payloadSize) {
+    using Header = Wire::RequestHeader;
+    std::array<uint8_t, REQUEST_HEADER_SIZE> header;
 
-    // Append the actual payload.
-    request.insert(request.end(), payload.begin(), payload.end());
+    // Client ID, version, request code and payload size.
+    Header::ClientId::put(header.data(), clientId.view());
+    Header::Version::put(header.data(), version);
+    Header::Code::put(header.data(), code);
+    Header::PayloadSize::put(header.data(), payloadSize);
 
-    return request;
+    return header;
 }
 
 std::vector<uint8_t> Protocol::createResponse(uint8_t version, uint16_t responseCode, const std::vector<uint8_t>& payload) {
-    std::vector<uint8_t> response;
-
-    // Append version (1 byte).
-    response.push_back(version);
-
-    // Append Response Code (2 bytes, little-endian).
-    response.push_back(responseCode & 0xFF);
-    response.push_back((responseCode >> 8) & 0xFF);
+    using Header = Wire::ResponseHeader;
+    ByteWriter response(RESPONSE_HEADER_SIZE + payload.size());
 
-    // Append Payload Size (4 bytes, little-endian).
-    uint32_t payloadSize = static_cast<uint32_t>(payload.size());
-    for (int i = 0; i < 4; i++) {
-        response.push_back((payloadSize >> (8 * i)) & 0xFF);
-    }
+    // Version, response code and payload size.
+    uint8_t* header = response.putSpace(Header::SIZE);
+    Header::Version::put(header, version);
+    Header::Code::put(header, responseCode);
+    Header::PayloadSize::put(header, static_cast<uint32_t>(payload.size()));
 
     // Append the payload.
-    response.insert(response.end(), payload.begin(), payload.end());
+    response.putBytes(payload.data(), payload.size());
 
-    return response;
+    return response.take();
 }
 
 std::tuple<uint8_t, uint16_t, std::vector<uint8_t>> Protocol::parseResponse(const std::vector<uint8_t>& data) {
-    const size_t headerSize = 7; // 1 byte for version, 2 bytes for response code, 4 bytes for payload size.
-    if (data.size() < headerSize) {
-        throw std::runtime_error("Data too short for response header");
-    }
-
-    // Extract the version.
-    uint8_t version = data[0];
-
-    // Extract the response code (little-endian).
-    uint16_t responseCode = data[1] | (data[2] << 8);
-
-    // Extract the payload size (little-endian).
-    uint32_t payloadSize = 0;
-    for (int i = 0; i < 4; i++) {
-        payloadSize |= (data[3 + i] << (8 * i));
-    }
+    // Extract the version, response code and payload size; throws if the header is truncated.
+    using Header = Wire::ResponseHeader;
+    const size_t headerSize = Header::SIZE;
+    const uint8_t* header = Wire::record<Header>(data);
+    uint8_t version = Header::Version::get(header);
+    uint16_t responseCode = Header::Code::get(header);
+    uint32_t payloadSize = Header::PayloadSize::get(header);
 
     // Validate that the data contains the full payload.
     if (data.size() < headerSize + payloadSize) {
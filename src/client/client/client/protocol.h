@@ -1,4 +1,6 @@
 ﻿#pragma once
+#include "ClientId.h"
+#include "WireSchema.h"
 
 /**
  * @brief Provides methods to create and parse protocol messages.
@@ -20,23 +22,45 @@
  */
 class Protocol {
 public:
+    static const size_t REQUEST_HEADER_SIZE = Wire::RequestHeader::SIZE;   ///< Client ID (16) + version (1) + request code (2) + payload size (4).
+    static const size_t RESPONSE_HEADER_SIZE = Wire::ResponseHeader::SIZE; ///< Version (1) + response code (2) + payload size (4).
+
     /**
      * @brief Creates a request message in the specified format.
      *
+     * This is a reference implementation of the request layout only: the client never builds a
+     * contiguous request, it sends the createRequestHeader header and the payload parts as
+     * separate buffers (see Client::sendRequestAsync).
+     *
      * The resulting vector of bytes is constructed as follows:
-     * - 16 bytes for the Client ID (if the provided clientId is shorter than 16 bytes, it is padded with '\0'; if longer, it is truncated).
+     * - 16 bytes for the Client ID.
      * - 1 byte for the Version.
      * - 2 bytes for the Request Code, encoded in little-endian order.
      * - 4 bytes for the Payload Size, encoded in little-endian order.
      * - The Payload itself.
      *
-     * @param clientId The client identifier as a string.
+     * @param clientId The client identifier (all zeros before registration).
      * @param version The version number of the client.
      * @param code The request code.
      * @param payload The payload data as a vector of bytes.
      * @return A vector of bytes representing the complete request message.
      */
-    static std::vector<uint8_t> createRequest(const std::string& clientId, uint8_t version, uint16_t code, const std::vector<uint8_t>& payload);
+    static std::vector<uint8_t> createRequest(const ClientId& clientId, uint8_t version, uint16_t code, const std::vector<uint8_t>& payload);
+
+    /**
+     * @brief Creates only the fixed-size header of a request message.
+     *
+     * The header has the same layout as the first 23 bytes produced by createRequest. It lets the
+     * caller send the header and the payload parts from where they already live, without
+     * building one contiguous request.
+     *
+     * @param clientId The client identifier (all zeros before registration).
+     * @param version The version number of the client.
+     * @param code The request code.
+     * @param payloadSize The total size of the payload that will follow the header.
+     * @return An array holding the 23-byte request header.
+     */
+    static std::array<uint8_t, REQUEST_HEADER_SIZE> createRequestHeader(const ClientId& clientId, uint8_t version, uint16_t code, uint32_t payloadSize);
 
     /**
      * @brief Creates a response message in the specified format.
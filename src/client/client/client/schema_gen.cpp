@@ -0,0 +1,63 @@
+﻿#include "WireSchema.h"
+
+// Writes the layouts of WireSchema.h as the server's struct format strings (communication/schema.py).
+// Usage: schema_gen [output file]; without an argument the module is written to stdout.
+
+template <typename Layout>
+static void writeLayout(std::ostream& out, const char* name) {
+    out << "\n" << name << "_FORMAT = \"<";
+    bool first = true;
+    for (const Wire::FieldInfo& info : Layout::FIELDS) {
+        out << (first ? "" : " ");
+        if (info.code == 's') {
+            out << info.size;
+        }
+        out << info.code;
+        first = false;
+    }
+    out << "\"\n" << name << "_SIZE = " << Layout::SIZE << "\n" << name << "_FIELDS = {";
+    first = true;
+    for (const Wire::FieldInfo& info : Layout::FIELDS) {
+        out << (first ? "\"" : ", \"") << info.name << "\": (" << info.offset << ", " << info.size << ")";
+        first = false;
+    }
+    out << "}\n";
+}
+
+static void writeSchema(std::ostream& out) {
+    out << "# Generated by schema_gen from src/client/client/client/WireSchema.h; do not edit.\n"
+        << "# Regenerate with: cmake --build <build dir> --target python_schema\n"
+        << "\n"
+        << "''' Fixed-size wire layouts shared with the C++ client.\n"
+        << "    For each layout: the struct format string (little-endian, no padding), its size in bytes\n"
+        << "    and its fields, in order, as name: (offset, size).\n"
+        << "'''\n";
+    writeLayout<Wire::RequestHeader>(out, "REQUEST_HEADER");
+    writeLayout<Wire::ResponseHeader>(out, "RESPONSE_HEADER");
+    writeLayout<Wire::Registration>(out, "REGISTRATION");
+    writeLayout<Wire::RegistrationRsa>(out, "REGISTRATION_RSA");
+    writeLayout<Wire::MessageHeader>(out, "MESSAGE_HEADER");
+    writeLayout<Wire::MulticastHeader>(out, "MULTICAST_HEADER");
+    writeLayout<Wire::SendStatus>(out, "SEND_STATUS");
+    writeLayout<Wire::MessageRecord>(out, "MESSAGE_RECORD");
+    writeLayout<Wire::MessageRecordV2>(out, "MESSAGE_RECORD_V2");
+    writeLayout<Wire::FetchPageRequest>(out, "FETCH_PAGE_REQUEST");
+    writeLayout<Wire::DirectorySyncRequest>(out, "DIRECTORY_SYNC_REQUEST");
+    writeLayout<Wire::DirectorySyncHeader>(out, "DIRECTORY_SYNC_HEADER");
+    writeLayout<Wire::ClientRecord>(out, "CLIENT_RECORD");
+    writeLayout<Wire::FileChunkHeader>(out, "FILE_CHUNK_HEADER");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        writeSchema(std::cout);
+        return 0;
+    }
+    std::ofstream file(argv[1], std::ios::binary | std::ios::trunc);
+    writeSchema(file);
+    if (!file) {
+        std::cerr << "Unable to write " << argv[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+﻿#pragma once
+#include "client.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Helpers shared by the client tests (Linux only): a scripted in-process server, and the files the
+// client reads from the directory of the test executable.
+
+inline void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        std::exit(1);
+    }
+}
+
+inline void writeExeFile(const std::string& name, const std::string& content) {
+    std::ofstream file(getPathInExeDirectory(name), std::ios::binary | std::ios::trunc);
+    file << content;
+    check(static_cast<bool>(file), "write " + name);
+}
+
+// Removes the configuration and cache files a client reads or writes, so each test starts fresh.
+inline void removeClientFiles() {
+    for (const char* name : { "server.info", "me.info", "directory.cache", "publickeys.cache", "peerversions.cache" }) {
+        std::remove(getPathInExeDirectory(name).c_str());
+    }
+}
+
+/**
+ * @brief A request as the test server received it.
+ */
+struct ReceivedRequest {
+    uint16_t code;
+    uint8_t version;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * @brief A server on a loopback port that answers every request with a scripted handler.
+ *
+ * Each connection is served on its own thread and every request is recorded. The handler returns
+ * the whole response (see Protocol::createResponse), or an empty vector to close the connection
+ * without answering.
+ */
+class TestServer {
+public:
+    using Handler = std::function<std::vector<uint8_t>(const ReceivedRequest& request)>;
+
+    explicit TestServer(Handler handler) : _handler(std::move(handler)) {
+        _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        check(::bind(_listener, reinterpret_cast<sockaddr*>(&address), length) == 0 && ::listen(_listener, 8) == 0
+            && ::getsockname(_listener, reinterpret_cast<sockaddr*>(&address), &length) == 0, "listen");
+        _port = ntohs(address.sin_port);
+        _acceptor = std::thread([this]() { acceptLoop(); });
+    }
+
+    ~TestServer() {
+        _stopping = true;
+        _acceptor.join();
+        dropConnections();
+        for (std::thread& connection : _connections) {
+            connection.join();
+        }
+        ::close(_listener);
+    }
+
+    unsigned short port() const { return _port; }
+
+    // The server.info line that points a client at this server, with the given pool settings.
+    std::string serverInfo(const std::string& settings = "") const {
+        return "127.0.0.1:" + std::to_string(_port) + "\n" + settings;
+    }
+
+    std::vector<ReceivedRequest> requests() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _requests;
+    }
+
+    size_t connectionCount() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _connections.size();
+    }
+
+    // Closes every open connection, as a server does with connections that stayed idle too long.
+    void dropConnections() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (int fd : _open) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+private:
+    void acceptLoop() {
+        while (!_stopping) {
+            pollfd listener{ _listener, POLLIN, 0 };
+            if (::poll(&listener, 1, 50) > 0) {
+                int fd = ::accept(_listener, nullptr, nullptr);
+                if (fd >= 0) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _open.push_back(fd);
+                    _connections.emplace_back([this, fd]() { serve(fd); });
+                }
+            }
+        }
+    }
+
+    void serve(int fd) {
+        std::array<uint8_t, Protocol::REQUEST_HEADER_SIZE> header;
+        while (readFully(fd, header.data(), header.size())) {
+            ReceivedRequest request;
+            request.code = Wire::RequestHeader::Code::get(header.data());
+            request.version = Wire::RequestHeader::Version::get(header.data());
+            request.payload.resize(Wire::RequestHeader::PayloadSize::get(header.data()));
+            if (!readFully(fd, request.payload.data(), request.payload.size())) {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _requests.push_back(request);
+            }
+            std::vector<uint8_t> response = _handler(request);
+            if (response.empty() || !writeFully(fd, response)) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _open.erase(std::find(_open.begin(), _open.end(), fd));
+        ::close(fd);
+    }
+
+    static bool readFully(int fd, uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t received = ::recv(fd, data, length, 0);
+            if (received <= 0) {
+                return false;
+            }
+            data += received;
+            length -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    static bool writeFully(int fd, const std::vector<uint8_t>& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    Handler _handler;
+    int _listener;
+    unsigned short _port;
+    std::atomic<bool> _stopping{ false };
+    std::thread _acceptor;
+    std::mutex _mutex;                      ///< Guards the members below.
+    std::vector<std::thread> _connections;
+    std::vector<int> _open;                 ///< Connections not closed yet.
+    std::vector<ReceivedRequest> _requests;
+};
\ No newline at end of file
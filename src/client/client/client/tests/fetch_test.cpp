@@ -0,0 +1,78 @@
+﻿#include "TestServer.h"
+
+// Fetches a page whose middle message can't be decrypted from a scripted in-process server, and
+// checks that the page is still displayed in full and acknowledged, so the next fetch does not
+// show it (and fail on it) again.
+
+static const ClientId SENDER_ID = ClientId::fromBytes("sender-client-id");
+
+// Appends a version 2 message record to a fetch page.
+static void putRecord(ByteWriter& page, uint32_t messageId, uint8_t type, const std::string& content) {
+    page.putBytes(SENDER_ID.view());
+    page.putUint32(messageId);
+    page.putUint8(type);
+    page.putUint8(2);
+    page.putUint32(static_cast<uint32_t>(content.size()));
+    page.putBytes(content);
+}
+
+int main() {
+    // The recipient's identity, and a session key the sender sends with RSA in the first message.
+    RSAPrivateWrapper recipientKey;
+    AESWrapper sessionKey;
+    AESWrapper otherKey;
+    std::string keyBytes(reinterpret_cast<const char*>(sessionKey.getKey()), AESWrapper::DEFAULT_KEYLENGTH);
+    std::string encryptedKey = RSAPublicWrapper(recipientKey.getPublicKey()).encrypt(keyBytes);
+    std::string first = "first message";
+    std::string third = "third message";
+
+    ByteWriter page;
+    putRecord(page, 1, 2, encryptedKey);
+    putRecord(page, 2, 3, sessionKey.seal(first.data(), first.size()));
+    // Sealed with another key: fails to authenticate, as with a stale key or a corrupted segment.
+    putRecord(page, 3, 3, otherKey.seal("undecryptable", 13));
+    putRecord(page, 4, 3, sessionKey.seal(third.data(), third.size()));
+
+    // Serves fetch requests (607) from the page; it is only returned to the first fetch.
+    std::vector<uint8_t> records = page.take();
+    TestServer server([&records](const ReceivedRequest& request) {
+        if (request.code != 607 || request.payload.size() != Wire::FetchPageRequest::SIZE) {
+            return Protocol::createResponse(2, 9000, {});
+        }
+        std::vector<uint8_t> response{ 0 }; // [1 byte "more" flag][records]
+        if (Wire::FetchPageRequest::AfterMessageId::get(request.payload.data()) == 0) {
+            response.insert(response.end(), records.begin(), records.end());
+        }
+        return Protocol::createResponse(2, 2107, response);
+    });
+    removeClientFiles();
+    writeExeFile("server.info", server.serverInfo());
+    writeExeFile("me.info", "recipient\n" + std::string(32, '1') + "\n" + Codec::base64Encode(recipientKey.getPrivateKey()) + "\n");
+
+    std::ostringstream output;
+    {
+        Client client;
+        std::streambuf* console = std::cout.rdbuf(output.rdbuf());
+        try {
+            client.fetchMessages();
+        }
+        catch (const std::exception& e) {
+            std::cout.rdbuf(console);
+            check(false, std::string("fetchMessages threw: ") + e.what());
+        }
+        std::cout.rdbuf(console);
+    }
+    removeClientFiles();
+
+    std::string shown = output.str();
+    check(shown.find("symmetric key received") != std::string::npos, "key message shown");
+    check(shown.find(first) != std::string::npos, "message before the bad one shown");
+    check(shown.find("can't decrypt message") != std::string::npos, "bad message rejected");
+    check(shown.find(third) != std::string::npos, "message after the bad one shown");
+    std::vector<ReceivedRequest> requests = server.requests();
+    check(!requests.empty() && requests.back().code == 607
+        && Wire::FetchPageRequest::AckMessageId::get(requests.back().payload.data()) == 4, "whole page acknowledged");
+
+    std::cout << "fetch_test passed" << std::endl;
+    return 0;
+}
\ No newline at end of file
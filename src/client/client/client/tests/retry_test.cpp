@@ -0,0 +1,76 @@
+﻿#include "TestServer.h"
+
+// Sends requests over pooled connections that the server has closed while they sat idle, with the
+// health check turned off so the client only finds out when it uses them. A page fetch (607) is safe
+// to repeat and must be sent again on a fresh connection; a message (603) must not be resent, since
+// the server may already have stored it.
+
+static size_t countRequests(TestServer& server, uint16_t code) {
+    size_t count = 0;
+    for (const ReceivedRequest& request : server.requests()) {
+        count += (request.code == code) ? 1 : 0;
+    }
+    return count;
+}
+
+int main() {
+    // Answers fetches (607) with an empty last page and stores messages (603).
+    TestServer server([](const ReceivedRequest& request) {
+        if (request.code == 607) {
+            return Protocol::createResponse(2, 2107, { 0 });
+        }
+        if (request.code == 603) {
+            return Protocol::createResponse(2, 2103, {});
+        }
+        return Protocol::createResponse(2, 9000, {});
+    });
+    RSAPrivateWrapper key;
+    removeClientFiles();
+    writeExeFile("server.info", server.serverInfo("healthCheck=0\n"));
+    writeExeFile("me.info", "sender\n" + std::string(32, '1') + "\n" + Codec::base64Encode(key.getPrivateKey()) + "\n");
+
+    std::ostringstream output;
+    std::streambuf* console = std::cout.rdbuf(output.rdbuf());
+    size_t fetchesBefore = 0;
+    size_t connectionsBefore = 0;
+    bool fetchFailed = false;
+    {
+        Client client;
+        client.fetchMessages();
+        check(server.connectionCount() == 1, "first request uses the warmed-up connection");
+
+        // The server closes the idle connection; the message goes out on it and is lost.
+        server.dropConnections();
+        ByteWriter message;
+        message.putPadded("recipient-id", ClientId::SIZE).putPadded("sender-id", ClientId::SIZE);
+        message.putUint8(3).putUint32(0);
+        try {
+            client.sendRequestAndReceiveResponse(603, message.take());
+        }
+        catch (const std::runtime_error&) {
+            // Sending may fail outright, or the response never arrives; either way it is surfaced.
+        }
+        check(countRequests(server, 603) == 0 && server.connectionCount() == 1, "message not resent on a new connection");
+
+        // A fetch on a connection closed the same way is sent again on a fresh one.
+        client.fetchMessages();
+        server.dropConnections();
+        fetchesBefore = countRequests(server, 607);
+        connectionsBefore = server.connectionCount();
+        try {
+            client.fetchMessages();
+        }
+        catch (const std::exception&) {
+            fetchFailed = true;
+        }
+    }
+    std::cout.rdbuf(console);
+    removeClientFiles();
+
+    check(!fetchFailed, "fetch on a closed pooled connection succeeds");
+    check(countRequests(server, 607) == fetchesBefore + 1 && server.connectionCount() == connectionsBefore + 1,
+        "fetch resent once on a new connection");
+
+    std::cout << "retry_test passed" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+﻿#include "TestServer.h"
+
+// Sends messages to peers the client has never received anything from, and checks which protocol
+// version each content goes out with: version 2 (AES-GCM) to a new RSA peer and to an X25519 peer,
+// even one recorded as version 1, and version 1 (AES-CBC) only to an RSA peer whose last message
+// was version 1, as recorded in the peer version cache of an earlier run.
+
+struct Peer {
+    std::string name;
+    ClientId id;
+    std::string publicKey;
+};
+
+// The content of the last 603 message of the given type to a peer, and the version it was sent with.
+static std::pair<uint8_t, std::string> sentContent(const std::vector<ReceivedRequest>& requests, const ClientId& to, uint8_t type) {
+    using Header = Wire::MessageHeader;
+    std::pair<uint8_t, std::string> found{ 0, "" };
+    for (const ReceivedRequest& request : requests) {
+        const uint8_t* header = request.payload.data();
+        if (request.code == 603 && request.payload.size() >= Header::SIZE
+            && Header::ToClientId::get(header) == to.view() && Header::Type::get(header) == type) {
+            found = { request.version, std::string(request.payload.begin() + Header::SIZE, request.payload.end()) };
+        }
+    }
+    check(found.first != 0, "message of type " + std::to_string(type) + " sent");
+    return found;
+}
+
+// The symmetric key sent to an RSA peer, as the peer decrypts it.
+static AESWrapper receivedKey(const std::vector<ReceivedRequest>& requests, const ClientId& to, RSAPrivateWrapper& peerKey) {
+    std::string key = peerKey.decrypt(sentContent(requests, to, 2).second);
+    return AESWrapper(reinterpret_cast<const unsigned char*>(key.data()), static_cast<unsigned int>(key.size()));
+}
+
+int main() {
+    const ClientId senderId = ClientId::fromBytes("sender-client-id");
+    X25519Wrapper senderKey;
+    RSAPrivateWrapper newPeerKey;
+    RSAPrivateWrapper oldPeerKey;
+    X25519Wrapper agreementPeerKey;
+    std::vector<Peer> peers = {
+        { "new-rsa-peer", ClientId::fromBytes("new-rsa-peer-id!"), newPeerKey.getPublicKey() },
+        { "old-rsa-peer", ClientId::fromBytes("old-rsa-peer-id!"), oldPeerKey.getPublicKey() },
+        { "x25519-peer", ClientId::fromBytes("x25519-peer-id!!"), agreementPeerKey.getPublicKey() },
+    };
+
+    // Serves the directory (608), the peers' public keys (602) and stores messages (603).
+    TestServer server([&peers](const ReceivedRequest& request) {
+        if (request.code == 608) {
+            ByteWriter directory;
+            uint8_t* header = directory.putSpace(Wire::DirectorySyncHeader::SIZE);
+            Wire::DirectorySyncHeader::Generation::put(header, 1);
+            Wire::DirectorySyncHeader::Full::put(header, 1);
+            for (const Peer& peer : peers) {
+                uint8_t* record = directory.putSpace(Wire::ClientRecord::SIZE);
+                Wire::ClientRecord::ClientId::put(record, peer.id.view());
+                Wire::ClientRecord::UserName::put(record, peer.name);
+            }
+            return Protocol::createResponse(2, 2108, directory.take());
+        }
+        if (request.code == 602) {
+            for (const Peer& peer : peers) {
+                if (std::string_view(reinterpret_cast<const char*>(request.payload.data()), request.payload.size()) == peer.id.view()) {
+                    return Protocol::createResponse(2, 2102, std::vector<uint8_t>(peer.publicKey.begin(), peer.publicKey.end()));
+                }
+            }
+        }
+        if (request.code == 603) {
+            return Protocol::createResponse(2, 2103, {});
+        }
+        return Protocol::createResponse(2, 9000, {});
+    });
+
+    // An earlier run received a version 1 message from the old RSA peer, and (wrongly) from the X25519 peer.
+    ByteWriter versions;
+    versions.putBytes("MUV1", 4).putUint32(2);
+    versions.putBytes(peers[1].id.view()).putUint8(1);
+    versions.putBytes(peers[2].id.view()).putUint8(1);
+    std::vector<uint8_t> versionCache = versions.take();
+    removeClientFiles();
+    writeExeFile("server.info", server.serverInfo());
+    writeExeFile("me.info", "sender\n" + Codec::hexEncode(senderId.view()) + "\n" + Codec::base64Encode(senderKey.getPrivateKey()) + "\n");
+    writeExeFile("peerversions.cache", std::string(versionCache.begin(), versionCache.end()));
+
+    const std::string toNew = "to a peer that never wrote";
+    const std::string toOld = "to a peer running an older client";
+    const std::string toAgreed = "to a peer with an agreed key";
+    try {
+        Client client;
+        client.sendSymmetricKey(peers[0].name);
+        client.sendMessage(peers[0].name, toNew);
+        client.sendSymmetricKey(peers[1].name);
+        client.sendMessage(peers[1].name, toOld);
+        client.sendMessage(peers[2].name, toAgreed);
+    }
+    catch (const std::exception& e) {
+        check(false, std::string("sending threw: ") + e.what());
+    }
+    removeClientFiles();
+
+    std::vector<ReceivedRequest> requests = server.requests();
+    auto [newVersion, newContent] = sentContent(requests, peers[0].id, 3);
+    check(newVersion == 2, "first message to a new peer sent as version 2");
+    check(receivedKey(requests, peers[0].id, newPeerKey).open(newContent.data(), newContent.size()) == toNew,
+        "first message to a new peer GCM-sealed");
+
+    auto [oldVersion, oldContent] = sentContent(requests, peers[1].id, 3);
+    check(oldVersion == 1, "message to a version 1 peer sent as version 1");
+    check(receivedKey(requests, peers[1].id, oldPeerKey).decrypt(oldContent.data(), static_cast<unsigned int>(oldContent.size())) == toOld,
+        "message to a version 1 peer CBC-encrypted");
+
+    // The peer derives the same key from its private key and the sender's public key.
+    auto [agreedVersion, agreedContent] = sentContent(requests, peers[2].id, 3);
+    std::string senderPublicKey = senderKey.getPublicKey();
+    std::string salt = std::string(std::min(senderId, peers[2].id).view()) + std::string(std::max(senderId, peers[2].id).view());
+    std::string agreed = agreementPeerKey.deriveKey(senderPublicKey.data(), static_cast<unsigned int>(senderPublicKey.size()), salt,
+        AESWrapper::DEFAULT_KEYLENGTH);
+    AESWrapper agreedKey(reinterpret_cast<const unsigned char*>(agreed.data()), static_cast<unsigned int>(agreed.size()));
+    check(agreedVersion == 2, "message under an agreed key sent as version 2");
+    check(agreedKey.open(agreedContent.data(), agreedContent.size()) == toAgreed, "message under an agreed key GCM-sealed");
+
+    std::cout << "send_test passed" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -1,31 +1,16 @@
 ﻿#include "utils.h"
 
 
-std::string bytesToHex(const std::string& bytes)
-{
-    std::ostringstream oss;
-    // Configure output stream for hexadecimal formatting with zero-padding.
-    oss << std::hex << std::setfill('0');
-    for (unsigned char c : bytes)
-    {
-        // Convert each byte to a two-digit hex string.
-        oss << std::setw(2) << static_cast<int>(c);
-    }
-    return oss.str();
-}
-
 bool checkMeInfoFileMissing()
 {
-	std::string exeDir = getExeDirectory();
-    std::string meInfoFilePath = exeDir + "\\me.info";
+    std::string meInfoFilePath = getPathInExeDirectory("me.info");
     // Return true if the file does not exist.
     return !std::filesystem::exists(meInfoFilePath);
 }
 
 std::string createFileInExeDir(const std::string& fileName)
 {
-	std::string exeDir = getExeDirectory();
-    std::string filePath = exeDir + "\\" + fileName;
+    std::string filePath = getPathInExeDirectory(fileName);
     std::ofstream file(filePath);
     if (!file.is_open()) {
         throw std::runtime_error("Unable to create file: " + filePath);
@@ -44,27 +29,27 @@ std::string trim(const std::string& s) {
     return (start < end ? std::string(start, end) : "");
 }
 
-// Helper: Adjusts a string to exactly 'size' bytes (pad with '\0' if too short; truncate if too long).
-std::string adjustToSize(const std::string& str, size_t size) {
-    std::string s = str;
-    if (s.size() < size) {
-        s.append(size - s.size(), '\0');
-    }
-    else if (s.size() > size) {
-        s = s.substr(0, size);
-    }
-    return s;
-}
-
 std::string getExeDirectory() {
+#ifdef _WIN32
     char exePath[MAX_PATH] = { 0 };
     if (GetModuleFileNameA(NULL, exePath, MAX_PATH) == 0) {
         throw std::runtime_error("GetModuleFileNameA failed");
     }
     std::string path(exePath);
+#else
+    std::error_code error;
+    std::string path = std::filesystem::read_symlink("/proc/self/exe", error).string();
+    if (error) {
+        throw std::runtime_error("Failed to read /proc/self/exe: " + error.message());
+    }
+#endif
     size_t pos = path.find_last_of("\\/");
     if (pos == std::string::npos) {
         throw std::runtime_error("Failed to determine executable directory");
     }
     return path.substr(0, pos);
+}
+
+std::string getPathInExeDirectory(const std::string& fileName) {
+    return (std::filesystem::path(getExeDirectory()) / fileName).string();
 }
\ No newline at end of file
@@ -8,25 +8,118 @@
 #include <filesystem>
 #include <fstream>
 #include <vector>
+#include <array>
+#include <initializer_list>
+#include <span>
+#include <string_view>
 #include <cstdint>
 #include <tuple>
 #include <cstring>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <stdexcept>
 #include <algorithm>
+#include <limits>
+#include <random>
+#include <future>
+#include <bit>
+
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
 
+typedef WSAPOLLFD SocketPollFd; ///< Entry of a socket poll set.
+
 /**
- * @brief Converts a binary buffer (16 bytes) into a hexadecimal string.
- *
- * Each two bytes in the output represent one byte of input in hexadecimal format.
- *
- * @param bytes A string containing the binary data.
- * @return A hexadecimal representation of the input data as a string.
+ * @brief Polls a set of sockets for readiness (WSAPoll).
  */
-std::string bytesToHex(const std::string& bytes);
+inline int pollSockets(SocketPollFd* fds, size_t count, int timeoutMs) {
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+}
+
+/**
+ * @brief Returns the error code of the last failed socket call.
+ */
+inline int lastSocketError() {
+    return WSAGetLastError();
+}
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+
+// POSIX equivalents of the WinSock names used throughout the client.
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+
+typedef pollfd SocketPollFd; ///< Entry of a socket poll set.
+
+inline int closesocket(SOCKET sock) {
+    return close(sock);
+}
+
+/**
+ * @brief Polls a set of sockets for readiness (poll).
+ */
+inline int pollSockets(SocketPollFd* fds, size_t count, int timeoutMs) {
+    return poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+
+/**
+ * @brief Returns the error code of the last failed socket call.
+ */
+inline int lastSocketError() {
+    return errno;
+}
+#endif
+
+/**
+ * @brief Reads a little-endian 16- or 32-bit value; a plain load on little-endian machines.
+ */
+inline uint16_t readUint16(const uint8_t* in) {
+    uint16_t value;
+    std::memcpy(&value, in, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = static_cast<uint16_t>((value << 8) | (value >> 8));
+    }
+    return value;
+}
+
+inline uint32_t readUint32(const uint8_t* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+    }
+    return value;
+}
+
+/**
+ * @brief Writes a 16- or 32-bit value in little-endian order; a plain store on little-endian machines.
+ */
+inline void writeUint16(uint8_t* out, uint16_t value) {
+    if constexpr (std::endian::native == std::endian::big) {
+        value = static_cast<uint16_t>((value << 8) | (value >> 8));
+    }
+    std::memcpy(out, &value, sizeof(value));
+}
+
+inline void writeUint32(uint8_t* out, uint32_t value) {
+    if constexpr (std::endian::native == std::endian::big) {
+        value = ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+    }
+    std::memcpy(out, &value, sizeof(value));
+}
 
 /**
  * @brief Checks whether the "me.info" file is missing in the executable directory.
@@ -58,24 +151,19 @@ std::string createFileInExeDir(const std::string& fileName);
 std::string trim(const std::string& s);
 
 /**
- * @brief Adjusts a string to a specified size by either padding or truncating it.
+ * @brief Retrieves the directory path of the current executable.
  *
- * If the input string is shorter than \p size, the function appends null characters ('\0')
- * to make it exactly \p size bytes long. If the input string is longer, it is truncated
- * to the first \p size bytes.
+ * This function uses the Windows API (GetModuleFileNameA) or, on Linux, /proc/self/exe to get
+ * the full path of the running executable, then extracts the directory portion from it.
  *
- * @param str The original string to adjust.
- * @param size The desired size (in bytes) of the returned string.
- * @return A new string of exactly \p size bytes.
+ * @return A string containing the path to the directory of the current executable.
  */
-std::string adjustToSize(const std::string& str, size_t size);
+std::string getExeDirectory();
 
 /**
- * @brief Retrieves the directory path of the current executable.
- *
- * This function uses Windows API (GetModuleFileNameA) to get the full path of the running
- * executable, then extracts the directory portion from it.
+ * @brief Builds the full path of a file located in the executable directory.
  *
- * @return A string containing the path to the directory of the current executable.
+ * @param fileName The name of the file.
+ * @return The executable directory joined with \p fileName using the platform's path separator.
  */
-std::string getExeDirectory();
\ No newline at end of file
+std::string getPathInExeDirectory(const std::string& fileName);
\ No newline at end of file
@@ -2,16 +2,40 @@ import logging
 import socket
 import struct
 import uuid
+from communication import schema
 from communication.protocol import Protocol
 from data.client_manager import ClientManager
 from data.message_manager import MessageManager
 
 ''' ConnectionHandler responsible for handling the connection with the client.
-    It receives the client's request, processes it, and sends a response back to the client.
+    It receives the client's requests, processes them, and sends a response back for each one.
+    A connection stays open for further requests until the client closes it or it stays idle
+    for KEEP_ALIVE_TIMEOUT seconds.
+    Each request is answered with the lower of its own version and SERVER_VERSION. From version 2 on,
+    stored messages keep the version they were sent with (version 2 contents are AES-GCM sealed rather
+    than AES-CBC encrypted) and fetched message records carry it after the message type.
+    A client registers either a 160-byte RSA public key (its peers send it their session keys) or a
+    32-byte X25519 public key (its peers agree on session keys with it); the server stores and returns
+    either one as is.
 '''
 
 class ConnectionHandler:
 
+    KEEP_ALIVE_TIMEOUT = 60.0
+    SERVER_VERSION = 2
+    SEND_STATUS_STORED = 0
+    SEND_STATUS_UNKNOWN_CLIENT = 1
+    FETCH_PAGE_FORMAT = schema.FETCH_PAGE_REQUEST_FORMAT
+    FETCH_PAGE_MAX_COUNT = 1000
+    DIRECTORY_SYNC_FORMAT = schema.DIRECTORY_SYNC_REQUEST_FORMAT
+    MESSAGE_RECORD_FORMAT = schema.MESSAGE_RECORD_FORMAT
+    MESSAGE_RECORD_FORMAT_V2 = schema.MESSAGE_RECORD_V2_FORMAT
+    SEND_STATUS_FORMAT = schema.SEND_STATUS_FORMAT
+    DIRECTORY_SYNC_HEADER_FORMAT = schema.DIRECTORY_SYNC_HEADER_FORMAT
+    USERNAME_SIZE = schema.REGISTRATION_FIELDS["username"][1]
+    RSA_PUBLIC_KEY_SIZE = schema.REGISTRATION_RSA_FIELDS["public_key"][1]
+    X25519_PUBLIC_KEY_SIZE = schema.REGISTRATION_FIELDS["public_key"][1]
+
     def __init__(self, client_socket: socket.socket, client_address: tuple[str, int], 
                  client_manager: ClientManager, message_manager: MessageManager) -> None:
         self.client_socket: socket.socket = client_socket
@@ -19,36 +43,24 @@ class ConnectionHandler:
         self.client_manager: ClientManager = client_manager
         self.message_manager: MessageManager = message_manager
 
-    # receive the client's request, process it, and send a response back to the client
+    # serve requests on this connection until the client closes it or stays idle for too long
     def handle(self) -> None:
         try:
             logging.debug("Entering handle() for client %s", self.client_address)
-            data: bytes = self.client_socket.recv(1024)
+            self.client_socket.settimeout(self.KEEP_ALIVE_TIMEOUT)
 
-            if not data:
-                logging.debug("No data received, returning...")
-                return
-            
-            client_id, version, request_code, payload = Protocol.parse_request(data)
-
-            if client_id and request_code not in [600, 601, 602, 603, 604]:
-                return self.send_response(9000, b"Invalid request format")
-
-            if request_code == 600:
-                response = self.handle_register(client_id, payload)
-            elif request_code == 601:
-                response = self.handle_client_list()
-            elif request_code == 602:
-                response = self.handle_get_public_key(payload)
-            elif request_code == 603:
-                response = self.handle_send_message(payload)
-            elif request_code == 604:
-                response = self.handle_fetch_messages(client_id)
-            else:
-                response = (9000, b"Unknown request code")
-
-            self.send_response(*response)
+            while True:
+                request = self.receive_request()
+                if request is None:
+                    logging.debug("Client %s closed the connection", self.client_address)
+                    return
+
+                client_id, version, request_code, payload = request
+                version = max(1, min(version, self.SERVER_VERSION))
+                self.send_response(*self.dispatch_request(client_id, version, request_code, payload), version)
 
+        except socket.timeout:
+            logging.info(f"Closing idle connection from {self.client_address}")
         except Exception as e:
             logging.exception(f"Exception in handle() for client {self.client_address}: {e}")
             self.send_response(9000, b"Server error in handle()")
@@ -56,15 +68,65 @@ class ConnectionHandler:
             self.client_socket.close()
 
 
+    # read one framed request (fixed header + declared payload), or None if the client closed the connection
+    def receive_request(self) -> tuple[bytes, int, int, bytes] | None:
+        header: bytes | None = self.receive_exact(Protocol.REQUEST_HEADER_SIZE)
+        if header is None:
+            return None
+
+        client_id, version, request_code, payload_size = Protocol.parse_request_header(header)
+        payload: bytes | None = self.receive_exact(payload_size)
+        if payload is None:
+            raise ConnectionError("Connection closed in the middle of a request")
+        return client_id, version, request_code, payload
+
+
+    def receive_exact(self, size: int) -> bytes | None:
+        chunks: list[bytes] = []
+        remaining: int = size
+        while remaining > 0:
+            chunk: bytes = self.client_socket.recv(min(remaining, 65536))
+            if not chunk:
+                if remaining == size:
+                    return None
+                raise ConnectionError("Connection closed in the middle of a request")
+            chunks.append(chunk)
+            remaining -= len(chunk)
+        return b"".join(chunks)
+
+
+    def dispatch_request(self, client_id: bytes, version: int, request_code: int, payload: bytes) -> tuple[int, bytes]:
+        if request_code == 600:
+            return self.handle_register(client_id, payload)
+        elif request_code == 601:
+            return self.handle_client_list()
+        elif request_code == 602:
+            return self.handle_get_public_key(payload)
+        elif request_code == 603:
+            return self.handle_send_message(payload, version)
+        elif request_code == 604:
+            return self.handle_fetch_messages(client_id, version)
+        elif request_code == 605:
+            return self.handle_send_messages(payload, version)
+        elif request_code == 606:
+            return self.handle_multicast_message(payload, version)
+        elif request_code == 607:
+            return self.handle_fetch_page(client_id, payload, version)
+        elif request_code == 608:
+            return self.handle_directory_sync(payload)
+        return (9000, b"Invalid request format")
+
+
     def handle_register(self, client_id: bytes, payload: bytes) -> tuple[int, bytes]:
         try:
-            if len(payload) != 415:
+            key_size = len(payload) - self.USERNAME_SIZE
+            if key_size not in (self.RSA_PUBLIC_KEY_SIZE, self.X25519_PUBLIC_KEY_SIZE):
                 print(f"payload length: {len(payload)}")
-                return (9000, b"Registration payload must be exactly 415 bytes")
+                return (9000, f"Registration payload must be exactly {schema.REGISTRATION_RSA_SIZE} (RSA) or {schema.REGISTRATION_SIZE} (X25519) bytes".encode())
 
-            name_bytes = payload[:255]
+            name_bytes = payload[:self.USERNAME_SIZE]
 
-            pubkey_bytes = payload[255:415]
+            pubkey_bytes = payload[self.USERNAME_SIZE:]
 
             name_str = name_bytes.split(b'\0', 1)[0].decode('ascii', errors='ignore')
 
@@ -81,12 +143,7 @@ class ConnectionHandler:
 
 
     def handle_client_list(self) -> tuple[int, bytes]:
-        clients: list[tuple[bytes, str]] = self.client_manager.get_all_clients()
-
-        response = b"".join(
-            struct.pack("16s 255s", c[0], c[1].encode())
-            for c in clients
-        )
+        response: bytes = self.client_manager.get_directory()
 
         if not response:
             return (9000, b"No clients found")
@@ -111,15 +168,16 @@ class ConnectionHandler:
             return (9000, f"Failed to fetch public key: {e}".encode())
         
 
-    def handle_send_message(self, payload: bytes) -> tuple[int, bytes]:
+    def handle_send_message(self, payload: bytes, version: int = 1) -> tuple[int, bytes]:
         try:
-            to_client, from_client, message_type, content_size = struct.unpack("<16s16sBI", payload[:37])
-            content = payload[37:]
+            to_client, from_client, message_type, content_size = struct.unpack_from(Protocol.MESSAGE_HEADER_FORMAT, payload)
+            content = payload[Protocol.MESSAGE_HEADER_SIZE:]
             self.message_manager.add_message(
                 to_client,
                 from_client,
                 message_type,
-                content
+                content,
+                version
             )
 
             return (2103, struct.pack("16sI", to_client, 1))
@@ -128,13 +186,49 @@ class ConnectionHandler:
             return (9000, f"server responded with an error: {e}".encode())
         
 
-    def handle_fetch_messages(self, client_id: str) -> tuple[int, bytes]:
+    # store a batch of 603-style records in one transaction; the response holds one
+    # [16 bytes to][4 bytes message ID][1 byte status] record per request record, in order
+    def handle_send_messages(self, payload: bytes, version: int = 1) -> tuple[int, bytes]:
+        try:
+            messages = Protocol.parse_message_records(payload)
+            message_ids = self.message_manager.add_messages(messages, version)
+
+            response: bytes = b"".join(
+                struct.pack(self.SEND_STATUS_FORMAT, message[0], message_id or 0,
+                            self.SEND_STATUS_STORED if message_id is not None else self.SEND_STATUS_UNKNOWN_CLIENT)
+                for message, message_id in zip(messages, message_ids)
+            )
+            return (2105, response)
+
+        except Exception as e:
+            return (9000, f"server responded with an error: {e}".encode())
+        
+
+    # store one content for a list of recipients; the response has the same per-recipient
+    # [16 bytes to][4 bytes message ID][1 byte status] records as the batch send
+    def handle_multicast_message(self, payload: bytes, version: int = 1) -> tuple[int, bytes]:
+        try:
+            from_client, message_type, recipients, content = Protocol.parse_multicast(payload)
+            message_ids = self.message_manager.add_multicast_message(from_client, recipients, message_type, content, version)
+
+            response: bytes = b"".join(
+                struct.pack(self.SEND_STATUS_FORMAT, to_client, message_id or 0,
+                            self.SEND_STATUS_STORED if message_id is not None else self.SEND_STATUS_UNKNOWN_CLIENT)
+                for to_client, message_id in zip(recipients, message_ids)
+            )
+            return (2106, response)
+
+        except Exception as e:
+            return (9000, f"server responded with an error: {e}".encode())
+        
+
+    def handle_fetch_messages(self, client_id: str, version: int = 1) -> tuple[int, bytes]:
         try:
             if not self.client_manager.client_exists_by_id(client_id):
                 return (9000, b"server responded with an error: Client not found")
             
-            messages: list[tuple[int, str, int, bytes]] = self.message_manager.get_messages_for_client(client_id)
-            response: bytes = b"".join(struct.pack("<16s I B I", msg[1], msg[0], msg[2], len(msg[3])) + msg[3] for msg in messages)
+            messages: list[tuple[int, str, int, bytes, int]] = self.message_manager.get_messages_for_client(client_id)
+            response: bytes = self.pack_message_records(messages, version)
 
             for msg in messages:
                 self.message_manager.delete_message(msg[0])
@@ -144,9 +238,59 @@ class ConnectionHandler:
             return (9000, f"server responded with an error: {e}".encode())
         
 
-    def send_response(self, response_code: int, payload: bytes) -> None:
+    # paged fetch: payload is [4 ack ID][4 after ID][4 max count][4 max bytes]. messages up to the
+    # acknowledged ID are deleted, then one page of messages after the other cursor is returned as
+    # [1 byte has more][2104-style records]
+    def handle_fetch_page(self, client_id: bytes, payload: bytes, version: int = 1) -> tuple[int, bytes]:
+        try:
+            if len(payload) != struct.calcsize(self.FETCH_PAGE_FORMAT):
+                return (9000, b"Paged fetch payload must be exactly 16 bytes")
+            if not self.client_manager.client_exists_by_id(client_id):
+                return (9000, b"server responded with an error: Client not found")
+
+            ack_id, after_id, max_count, max_bytes = struct.unpack(self.FETCH_PAGE_FORMAT, payload)
+            self.message_manager.delete_messages_up_to(client_id, ack_id)
+            max_count = max(1, min(max_count, self.FETCH_PAGE_MAX_COUNT))
+            messages, has_more = self.message_manager.get_message_page(
+                client_id, after_id, max_count, max_bytes, struct.calcsize(self.message_record_format(version)))
+
+            response: bytes = struct.pack("<B", 1 if has_more else 0) + self.pack_message_records(messages, version)
+            return (2107, response)
+
+        except Exception as e:
+            return (9000, f"server responded with an error: {e}".encode())
+        
+
+    # incremental directory: payload is [4 bytes known generation]. the response is [4 bytes current generation]
+    # [1 byte full flag] followed by 601-style records of the clients added after the known generation
+    # (or of every client, when the full flag is set)
+    def handle_directory_sync(self, payload: bytes) -> tuple[int, bytes]:
+        try:
+            if len(payload) != struct.calcsize(self.DIRECTORY_SYNC_FORMAT):
+                return (9000, b"Directory sync payload must be exactly 4 bytes")
+            (known_generation,) = struct.unpack(self.DIRECTORY_SYNC_FORMAT, payload)
+            generation, records, full = self.client_manager.get_directory_since(known_generation)
+            return (2108, struct.pack(self.DIRECTORY_SYNC_HEADER_FORMAT, generation, 1 if full else 0) + records)
+
+        except Exception as e:
+            return (9000, f"server responded with an error: {e}".encode())
+        
+
+    # 2104 record header: [16 from][4 message ID][1 type][4 content size], with [1 version] after the type from version 2
+    def message_record_format(self, version: int) -> str:
+        return self.MESSAGE_RECORD_FORMAT_V2 if version >= 2 else self.MESSAGE_RECORD_FORMAT
+
+
+    def pack_message_records(self, messages: list[tuple], version: int) -> bytes:
+        if version >= 2:
+            return b"".join(struct.pack(self.MESSAGE_RECORD_FORMAT_V2, msg[1], msg[0], msg[2], msg[4], len(msg[3])) + msg[3]
+                            for msg in messages)
+        return b"".join(struct.pack(self.MESSAGE_RECORD_FORMAT, msg[1], msg[0], msg[2], len(msg[3])) + msg[3] for msg in messages)
+
+
+    def send_response(self, response_code: int, payload: bytes, version: int = 1) -> None:
         try:
-            response: bytes = Protocol.create_response(1, response_code, payload)
+            response: bytes = Protocol.create_response(version, response_code, payload)
             self.client_socket.sendall(response)
 
         except Exception as e:
@@ -1,4 +1,5 @@
 import struct
+from communication import schema
 
 ''' Protocol class is used to create and parse request from client to server and response from server to client.
     The Protocol class is used by both client and server to create and parse request and response.
@@ -19,14 +20,24 @@ import struct
     
     The create_request method takes client_id, version, request_code and payload as input and returns serialized request.
     The parse_request method takes serialized request as input and returns client_id, version, request_code and payload.
+    The parse_request_header method takes the fixed-size request header and returns client_id, version, request_code and payload_size.
+    The parse_message_records method splits a message payload into [to][from][type][size][content] records.
+    The parse_multicast method splits a multicast payload into sender, message type, recipient list and content.
     The create_response method takes version, response_code and payload as input and returns serialized response.
     The parse_response method takes serialized response as input and returns version, response_code and payload.  
+    The layouts come from communication/schema.py, which is generated from the C++ client's WireSchema.h.
 '''
 
 class Protocol:
 
-    REQUEST_HEADER_FORMAT = "<16s B H I"
-    RESPONSE_HEADER_FORMAT = "<B H I"
+    REQUEST_HEADER_FORMAT = schema.REQUEST_HEADER_FORMAT
+    RESPONSE_HEADER_FORMAT = schema.RESPONSE_HEADER_FORMAT
+    REQUEST_HEADER_SIZE = schema.REQUEST_HEADER_SIZE
+    RESPONSE_HEADER_SIZE = schema.RESPONSE_HEADER_SIZE
+    MESSAGE_HEADER_FORMAT = schema.MESSAGE_HEADER_FORMAT
+    MESSAGE_HEADER_SIZE = schema.MESSAGE_HEADER_SIZE
+    MULTICAST_HEADER_FORMAT = schema.MULTICAST_HEADER_FORMAT
+    MULTICAST_HEADER_SIZE = schema.MULTICAST_HEADER_SIZE
 
     @staticmethod
     def create_request(client_id: bytes, version: int, request_code: int, payload: bytes) -> bytes:
@@ -41,7 +52,7 @@ class Protocol:
 
     @staticmethod
     def parse_request(data: bytes) -> tuple[bytes, int, int, bytes]:
-        header_size = struct.calcsize(Protocol.REQUEST_HEADER_FORMAT)
+        header_size = Protocol.REQUEST_HEADER_SIZE
         if len(data) < header_size:
             raise ValueError("Data too short for declared payload")
         
@@ -53,6 +64,40 @@ class Protocol:
         payload = data[header_size:header_size + payload_size]
         return cid, version, request_code, payload
 
+    @staticmethod
+    def parse_request_header(data: bytes) -> tuple[bytes, int, int, int]:
+        if len(data) < Protocol.REQUEST_HEADER_SIZE:
+            raise ValueError("Data too short for request header")
+        return struct.unpack(Protocol.REQUEST_HEADER_FORMAT, data[:Protocol.REQUEST_HEADER_SIZE])
+
+    @staticmethod
+    def parse_message_records(payload: bytes) -> list[tuple[bytes, bytes, int, bytes]]:
+        records = []
+        offset = 0
+        while offset < len(payload):
+            if len(payload) - offset < Protocol.MESSAGE_HEADER_SIZE:
+                raise ValueError("Data too short for message header")
+            to_client, from_client, message_type, content_size = struct.unpack_from(Protocol.MESSAGE_HEADER_FORMAT, payload, offset)
+            offset += Protocol.MESSAGE_HEADER_SIZE
+            if len(payload) - offset < content_size:
+                raise ValueError("Data too short for declared message content")
+            records.append((to_client, from_client, message_type, payload[offset:offset + content_size]))
+            offset += content_size
+        return records
+
+    # multicast payload: [16 from][1 type][2 recipient count][4 content size][count x 16 recipient IDs][content]
+    @staticmethod
+    def parse_multicast(payload: bytes) -> tuple[bytes, int, list[bytes], bytes]:
+        if len(payload) < Protocol.MULTICAST_HEADER_SIZE:
+            raise ValueError("Data too short for multicast header")
+        from_client, message_type, recipient_count, content_size = struct.unpack_from(Protocol.MULTICAST_HEADER_FORMAT, payload)
+        offset = Protocol.MULTICAST_HEADER_SIZE
+        if len(payload) != offset + 16 * recipient_count + content_size:
+            raise ValueError("Multicast payload size does not match its header")
+        recipients = [payload[offset + 16 * i:offset + 16 * (i + 1)] for i in range(recipient_count)]
+        content = payload[offset + 16 * recipient_count:]
+        return from_client, message_type, recipients, content
+
     @staticmethod
     def create_response(version: int, response_code: int, payload: bytes) -> bytes:
         payload_size = len(payload)
@@ -61,7 +106,7 @@ class Protocol:
 
     @staticmethod
     def parse_response(data: bytes) -> tuple[int, int, bytes]:
-        header_size = struct.calcsize(Protocol.RESPONSE_HEADER_FORMAT)
+        header_size = Protocol.RESPONSE_HEADER_SIZE
         if len(data) < header_size:
             raise ValueError("Data too short for response header")
         version, response_code, payload_size = struct.unpack(Protocol.RESPONSE_HEADER_FORMAT, data[:header_size])
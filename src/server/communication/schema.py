@@ -0,0 +1,63 @@
+# Generated by schema_gen from src/client/client/client/WireSchema.h; do not edit.
+# Regenerate with: cmake --build <build dir> --target python_schema
+
+''' Fixed-size wire layouts shared with the C++ client.
+    For each layout: the struct format string (little-endian, no padding), its size in bytes
+    and its fields, in order, as name: (offset, size).
+'''
+
+REQUEST_HEADER_FORMAT = "<16s B H I"
+REQUEST_HEADER_SIZE = 23
+REQUEST_HEADER_FIELDS = {"client_id": (0, 16), "version": (16, 1), "code": (17, 2), "payload_size": (19, 4)}
+
+RESPONSE_HEADER_FORMAT = "<B H I"
+RESPONSE_HEADER_SIZE = 7
+RESPONSE_HEADER_FIELDS = {"version": (0, 1), "code": (1, 2), "payload_size": (3, 4)}
+
+REGISTRATION_FORMAT = "<255s 32s"
+REGISTRATION_SIZE = 287
+REGISTRATION_FIELDS = {"username": (0, 255), "public_key": (255, 32)}
+
+REGISTRATION_RSA_FORMAT = "<255s 160s"
+REGISTRATION_RSA_SIZE = 415
+REGISTRATION_RSA_FIELDS = {"username": (0, 255), "public_key": (255, 160)}
+
+MESSAGE_HEADER_FORMAT = "<16s 16s B I"
+MESSAGE_HEADER_SIZE = 37
+MESSAGE_HEADER_FIELDS = {"to_client_id": (0, 16), "from_client_id": (16, 16), "type": (32, 1), "content_size": (33, 4)}
+
+MULTICAST_HEADER_FORMAT = "<16s B H I"
+MULTICAST_HEADER_SIZE = 23
+MULTICAST_HEADER_FIELDS = {"from_client_id": (0, 16), "type": (16, 1), "recipient_count": (17, 2), "content_size": (19, 4)}
+
+SEND_STATUS_FORMAT = "<16s I B"
+SEND_STATUS_SIZE = 21
+SEND_STATUS_FIELDS = {"to_client_id": (0, 16), "message_id": (16, 4), "status": (20, 1)}
+
+MESSAGE_RECORD_FORMAT = "<16s I B I"
+MESSAGE_RECORD_SIZE = 25
+MESSAGE_RECORD_FIELDS = {"from_client_id": (0, 16), "message_id": (16, 4), "type": (20, 1), "content_size": (21, 4)}
+
+MESSAGE_RECORD_V2_FORMAT = "<16s I B B I"
+MESSAGE_RECORD_V2_SIZE = 26
+MESSAGE_RECORD_V2_FIELDS = {"from_client_id": (0, 16), "message_id": (16, 4), "type": (20, 1), "version": (21, 1), "content_size": (22, 4)}
+
+FETCH_PAGE_REQUEST_FORMAT = "<I I I I"
+FETCH_PAGE_REQUEST_SIZE = 16
+FETCH_PAGE_REQUEST_FIELDS = {"ack_message_id": (0, 4), "after_message_id": (4, 4), "max_count": (8, 4), "max_bytes": (12, 4)}
+
+DIRECTORY_SYNC_REQUEST_FORMAT = "<I"
+DIRECTORY_SYNC_REQUEST_SIZE = 4
+DIRECTORY_SYNC_REQUEST_FIELDS = {"generation": (0, 4)}
+
+DIRECTORY_SYNC_HEADER_FORMAT = "<I B"
+DIRECTORY_SYNC_HEADER_SIZE = 5
+DIRECTORY_SYNC_HEADER_FIELDS = {"generation": (0, 4), "full": (4, 1)}
+
+CLIENT_RECORD_FORMAT = "<16s 255s"
+CLIENT_RECORD_SIZE = 271
+CLIENT_RECORD_FIELDS = {"client_id": (0, 16), "username": (16, 255)}
+
+FILE_CHUNK_HEADER_FORMAT = "<I I I"
+FILE_CHUNK_HEADER_SIZE = 12
+FILE_CHUNK_HEADER_FIELDS = {"transfer_id": (0, 4), "index": (4, 4), "count": (8, 4)}
@@ -1,23 +1,36 @@
+from communication import schema
 from data.database_manager import DatabaseManager
+import bisect
 import sqlite3
+import struct
+import threading
 
 ''' ClientManager class is responsible for managing clients in the database.
     It provides methods for adding clients, getting public keys, updating last seen time,
     getting all clients, and checking if a client exists by ID or username. 
+    It also keeps the client directory: every client has a generation number, and the packed
+    [16 bytes ID][255 bytes username] records are cached in generation order, so a directory request
+    only packs the clients added since the previous one.
 '''
 
 class ClientManager:
+    DIRECTORY_RECORD_FORMAT = schema.CLIENT_RECORD_FORMAT
+    DIRECTORY_RECORD_SIZE = schema.CLIENT_RECORD_SIZE
 
     def __init__(self, db_manager: DatabaseManager):
         self.db_manager: DatabaseManager = db_manager
+        # the manager is shared by the connection threads
+        self._directory_lock = threading.Lock()
+        self._directory_records = bytearray()
+        self._directory_generations: list[int] = []
 
 
     def add_client(self, client_id: str, username: str, public_key: bytes):
         if self.client_exists_by_username(username):
             raise ValueError(f"Client with username '{username}' already exists.")
         
-        query = '''INSERT INTO clients (ID, UserName, PublicKey, LastSeen)
-                   VALUES (?, ?, ?, datetime('now'))'''
+        query = '''INSERT INTO clients (ID, UserName, PublicKey, LastSeen, Generation)
+                   VALUES (?, ?, ?, datetime('now'), (SELECT COALESCE(MAX(Generation), 0) + 1 FROM clients))'''
         params = (client_id, username, public_key)
 
         try:
@@ -54,6 +67,36 @@ class ClientManager:
 
         return clients
     
+
+    # the packed directory records of every client, in generation order
+    def get_directory(self) -> bytes:
+        with self._directory_lock:
+            self._refresh_directory()
+            return bytes(self._directory_records)
+
+
+    # the current directory generation and the packed records of the clients added after known_generation.
+    # a client that knows a generation the server does not have (e.g. after a database reset) gets the whole
+    # directory, which the returned flag marks as a full replacement
+    def get_directory_since(self, known_generation: int) -> tuple[int, bytes, bool]:
+        with self._directory_lock:
+            self._refresh_directory()
+            generation = self._directory_generations[-1] if self._directory_generations else 0
+            if known_generation == 0 or known_generation > generation:
+                return generation, bytes(self._directory_records), True
+            first = bisect.bisect_right(self._directory_generations, known_generation)
+            return generation, bytes(self._directory_records[first * self.DIRECTORY_RECORD_SIZE:]), False
+
+
+    # packs the clients added since the last refresh onto the cached directory; callers hold the lock
+    def _refresh_directory(self) -> None:
+        known = self._directory_generations[-1] if self._directory_generations else 0
+        query = '''SELECT ID, UserName, Generation FROM clients WHERE Generation > ? ORDER BY Generation'''
+        for id_val, user_name, generation in self.db_manager.fetch_query(query, (known,)):
+            id_bytes = bytes.fromhex(id_val) if isinstance(id_val, str) else id_val
+            self._directory_records += struct.pack(self.DIRECTORY_RECORD_FORMAT, id_bytes, user_name.encode())
+            self._directory_generations.append(generation)
+    
     
     def client_exists_by_id(self, client_id) -> bool:
         query = '''SELECT 1 FROM clients WHERE ID = ?'''
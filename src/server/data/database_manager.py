@@ -1,8 +1,10 @@
 import sqlite3
 import os
+from contextlib import contextmanager
 
 ''' DatabaseManager class for managing the SQLite database.
-    It provides methods for executing and fetching queries.
+    It provides methods for executing and fetching queries, and for executing a batch of
+    queries (or any sequence of statements) in a single transaction.
 '''
 
 class DatabaseManager:
@@ -22,7 +24,23 @@ class DatabaseManager:
                                     ID BOLD PRIMARY KEY,
                                     UserName TEXT NOT NULL UNIQUE,
                                     PublicKey BLOB NOT NULL,
-                                    LastSeen TEXT
+                                    LastSeen TEXT,
+                                    Generation INTEGER
+                                )''')
+
+                # every new client gets the next directory generation, so clients can sync incrementally.
+                # databases created before the directory was versioned number their clients in insertion order
+                columns = [row[1] for row in cursor.execute("PRAGMA table_info(clients)")]
+                if "Generation" not in columns:
+                    cursor.execute("ALTER TABLE clients ADD COLUMN Generation INTEGER")
+                cursor.execute("UPDATE clients SET Generation = rowid WHERE Generation IS NULL")
+                cursor.execute("CREATE INDEX IF NOT EXISTS clients_generation ON clients(Generation)")
+
+                # content shared by several mailbox entries (multicast) is stored once, with a reference count
+                cursor.execute('''CREATE TABLE IF NOT EXISTS contents (
+                                    ID INTEGER PRIMARY KEY AUTOINCREMENT,
+                                    Content BLOB NOT NULL,
+                                    RefCount INTEGER NOT NULL
                                 )''')
 
                 cursor.execute('''CREATE TABLE IF NOT EXISTS messages (
@@ -31,10 +49,23 @@ class DatabaseManager:
                                     FromClient TEXT NOT NULL,
                                     Type INTEGER NOT NULL,
                                     Content BLOB NOT NULL,
+                                    ContentID INTEGER,
+                                    Version INTEGER NOT NULL DEFAULT 1,
                                     FOREIGN KEY (ToClient) REFERENCES clients(ID),
-                                    FOREIGN KEY (FromClient) REFERENCES clients(ID)
+                                    FOREIGN KEY (FromClient) REFERENCES clients(ID),
+                                    FOREIGN KEY (ContentID) REFERENCES contents(ID)
                                 )''')
 
+                # databases created before shared contents existed lack the ContentID column
+                columns = [row[1] for row in cursor.execute("PRAGMA table_info(messages)")]
+                if "ContentID" not in columns:
+                    cursor.execute("ALTER TABLE messages ADD COLUMN ContentID INTEGER REFERENCES contents(ID)")
+
+                # the protocol version a message was sent with tells the recipient how its content is encrypted;
+                # messages stored before it was recorded are version 1
+                if "Version" not in columns:
+                    cursor.execute("ALTER TABLE messages ADD COLUMN Version INTEGER NOT NULL DEFAULT 1")
+
                 conn.commit()
         except sqlite3.Error as e:
             raise sqlite3.DatabaseError(f"Error initializing database: {e}")
@@ -50,6 +81,26 @@ class DatabaseManager:
             raise sqlite3.DatabaseError(f"Error executing query: {e}")
         
 
+    def execute_batch(self, query: str, params_list) -> list[int]:
+        # all rows are written in one transaction: either every row is stored or none is
+        with self.transaction() as cursor:
+            row_ids = []
+            for params in params_list:
+                cursor.execute(query, params)
+                row_ids.append(cursor.lastrowid)
+            return row_ids
+
+
+    # yields a cursor; everything executed on it is committed together, or rolled back on error
+    @contextmanager
+    def transaction(self):
+        try:
+            with sqlite3.connect(self.db_name) as conn:
+                yield conn.cursor()
+        except sqlite3.Error as e:
+            raise sqlite3.DatabaseError(f"Error executing transaction: {e}")
+        
+
     def fetch_query(self, query: str, params=()):
         try:
             with sqlite3.connect(self.db_name) as conn:
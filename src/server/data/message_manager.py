@@ -2,7 +2,13 @@ from data.client_manager import ClientManager
 from data.database_manager import DatabaseManager
 
 ''' MessageManager class is responsible for managing messages in the database.
-    It provides methods for adding messages, getting messages for a client, and deleting messages.
+    It provides methods for adding messages (one at a time, as a batch, or as one content sent to many
+    recipients), getting messages for a client (all at once or page by page), and deleting messages
+    (one at a time or all up to an acknowledged message ID).
+    Every message keeps the protocol version of the request that stored it, which tells the recipient
+    how the content is encrypted; fetched messages are (ID, FromClient, Type, Content, Version) rows.
+    A multicast content is stored once in the contents table; each recipient's mailbox entry refers
+    to it through ContentID, and the content is deleted with the last entry that refers to it.
 '''
 
 class MessageManager:
@@ -12,28 +18,87 @@ class MessageManager:
         self.client_manager: ClientManager = client_manager
 
 
-    def add_message(self, to_client: str, from_client: str, message_type: int, content: bytes) -> None:
+    def add_message(self, to_client: str, from_client: str, message_type: int, content: bytes, version: int = 1) -> None:
         if not self.client_manager.client_exists_by_id(to_client):
             raise ValueError(f"Recipient client {to_client} does not exist.")
         
         if not self.client_manager.client_exists_by_id(from_client):
             raise ValueError(f"Sender client {from_client} does not exist.")
 
-        query = '''INSERT INTO messages (ToClient, FromClient, Type, Content)
-                   VALUES (?, ?, ?, ?)'''
+        query = '''INSERT INTO messages (ToClient, FromClient, Type, Content, Version)
+                   VALUES (?, ?, ?, ?, ?)'''
         try:
-            params = (to_client, from_client, message_type, content)
+            params = (to_client, from_client, message_type, content, version)
             self.db_manager.execute_query(query, params)
             print("Message added successfully to the database.")
 
         except Exception as e:
             raise RuntimeError(f"Database error while adding message: {e}")
 
+
+    # store a batch of (to_client, from_client, message_type, content) records, all sent with the same
+    # protocol version, in one transaction.
+    # returns the new message ID of each record, or None for records whose sender or recipient is unknown
+    def add_messages(self, messages: list[tuple[bytes, bytes, int, bytes]], version: int = 1) -> list[int | None]:
+        known_clients: dict[bytes, bool] = {}
+
+        def client_exists(client_id: bytes) -> bool:
+            if client_id not in known_clients:
+                known_clients[client_id] = self.client_manager.client_exists_by_id(client_id)
+            return known_clients[client_id]
+
+        accepted: list[int] = [i for i, (to_client, from_client, _, _) in enumerate(messages)
+                               if client_exists(to_client) and client_exists(from_client)]
+
+        query = '''INSERT INTO messages (ToClient, FromClient, Type, Content, Version)
+                   VALUES (?, ?, ?, ?, ?)'''
+        try:
+            message_ids = self.db_manager.execute_batch(query, [(*messages[i], version) for i in accepted])
+            print(f"{len(message_ids)} of {len(messages)} messages added to the database.")
+
+        except Exception as e:
+            raise RuntimeError(f"Database error while adding messages: {e}")
+
+        results: list[int | None] = [None] * len(messages)
+        for index, message_id in zip(accepted, message_ids):
+            results[index] = message_id
+        return results
+
+
+    # store one content for many recipients: the blob is written once and every known recipient
+    # gets a mailbox entry referring to it. returns the new message ID per recipient (None if unknown)
+    def add_multicast_message(self, from_client: bytes, recipients: list[bytes], message_type: int, content: bytes,
+                              version: int = 1) -> list[int | None]:
+        if not self.client_manager.client_exists_by_id(from_client):
+            raise ValueError(f"Sender client {from_client} does not exist.")
+
+        accepted: list[int] = [i for i, to_client in enumerate(recipients) if self.client_manager.client_exists_by_id(to_client)]
+        results: list[int | None] = [None] * len(recipients)
+        if not accepted:
+            return results
+
+        try:
+            with self.db_manager.transaction() as cursor:
+                cursor.execute('''INSERT INTO contents (Content, RefCount) VALUES (?, ?)''', (content, len(accepted)))
+                content_id = cursor.lastrowid
+                for index in accepted:
+                    cursor.execute('''INSERT INTO messages (ToClient, FromClient, Type, Content, ContentID, Version)
+                                      VALUES (?, ?, ?, ?, ?, ?)''',
+                                   (recipients[index], from_client, message_type, b"", content_id, version))
+                    results[index] = cursor.lastrowid
+            print(f"Multicast message stored once for {len(accepted)} of {len(recipients)} recipients.")
+
+        except Exception as e:
+            raise RuntimeError(f"Database error while adding multicast message: {e}")
+        return results
+
         
     def get_messages_for_client(self, client_id) -> list[tuple]:
-        query = '''SELECT ID, FromClient, Type, Content
-                   FROM messages
-                   WHERE ToClient = ?'''
+        # mailbox entries of a multicast carry no content of their own; it is read from the shared row
+        query = '''SELECT m.ID, m.FromClient, m.Type, COALESCE(c.Content, m.Content), m.Version
+                   FROM messages m
+                   LEFT JOIN contents c ON m.ContentID = c.ID
+                   WHERE m.ToClient = ?'''
         try:
             message = self.db_manager.fetch_query(query, (client_id,))
             print("Messages fetched successfully.")
@@ -44,16 +109,76 @@ class MessageManager:
             return []
         
 
+    # one page of a client's messages with ID > after_id, in ID order: at most max_count messages and,
+    # unless the first message alone is larger, at most max_bytes of records (record header + content).
+    # only the contents of the selected page are loaded. returns the page and whether more messages follow
+    def get_message_page(self, client_id, after_id: int, max_count: int, max_bytes: int,
+                         record_header_size: int = 25) -> tuple[list[tuple], bool]:
+        size_query = '''SELECT m.ID, length(COALESCE(c.Content, m.Content))
+                        FROM messages m
+                        LEFT JOIN contents c ON m.ContentID = c.ID
+                        WHERE m.ToClient = ? AND m.ID > ?
+                        ORDER BY m.ID
+                        LIMIT ?'''
+        sizes = self.db_manager.fetch_query(size_query, (client_id, after_id, max_count + 1))
+
+        page_ids: list[int] = []
+        page_bytes = 0
+        for message_id, content_size in sizes[:max_count]:
+            record_size = record_header_size + content_size
+            if page_ids and page_bytes + record_size > max_bytes:
+                break
+            page_ids.append(message_id)
+            page_bytes += record_size
+        has_more = len(sizes) > len(page_ids)
+        if not page_ids:
+            return [], has_more
+
+        query = '''SELECT m.ID, m.FromClient, m.Type, COALESCE(c.Content, m.Content), m.Version
+                   FROM messages m
+                   LEFT JOIN contents c ON m.ContentID = c.ID
+                   WHERE m.ToClient = ? AND m.ID BETWEEN ? AND ?
+                   ORDER BY m.ID'''
+        return self.db_manager.fetch_query(query, (client_id, page_ids[0], page_ids[-1])), has_more
+
+
+    # delete every message of a client up to and including ack_id, releasing shared contents
+    def delete_messages_up_to(self, client_id, ack_id: int) -> int:
+        try:
+            with self.db_manager.transaction() as cursor:
+                content_refs = cursor.execute('''SELECT ContentID, COUNT(*) FROM messages
+                                                 WHERE ToClient = ? AND ID <= ? AND ContentID IS NOT NULL
+                                                 GROUP BY ContentID''', (client_id, ack_id)).fetchall()
+                deleted = cursor.execute('''DELETE FROM messages WHERE ToClient = ? AND ID <= ?''', (client_id, ack_id)).rowcount
+                for content_id, references in content_refs:
+                    cursor.execute('''UPDATE contents SET RefCount = RefCount - ? WHERE ID = ?''', (references, content_id))
+                    cursor.execute('''DELETE FROM contents WHERE ID = ? AND RefCount <= 0''', (content_id,))
+            if deleted:
+                print(f"{deleted} acknowledged messages deleted.")
+            return deleted
+
+        except Exception as e:
+            raise RuntimeError(f"Database: {e}")
+
+
     def delete_message(self, message_id: int) -> None:
         query_check = '''SELECT ID FROM messages WHERE ID = ?'''
+        query_content = '''SELECT ContentID FROM messages WHERE ID = ?'''
         query_delete = '''DELETE FROM messages WHERE ID = ?'''
 
-        if not self.db_manager.fetch_query(query_check, (message_id,)):
+        rows = self.db_manager.fetch_query(query_content, (message_id,))
+        if not rows:
             print(f"Message {message_id} does not exist.")
             return
+        content_id = rows[0][0]
         
         try:
-            self.db_manager.execute_query(query_delete, (message_id,))
+            with self.db_manager.transaction() as cursor:
+                cursor.execute(query_delete, (message_id,))
+                # release the shared content; the last reference deletes it
+                if content_id is not None:
+                    cursor.execute('''UPDATE contents SET RefCount = RefCount - 1 WHERE ID = ?''', (content_id,))
+                    cursor.execute('''DELETE FROM contents WHERE ID = ? AND RefCount <= 0''', (content_id,))
             print(f"Message {message_id} deleted successfully.")
             remaining_messages = self.db_manager.fetch_query(query_check, (message_id,))
             if remaining_messages:
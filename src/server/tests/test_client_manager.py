@@ -1,4 +1,6 @@
 import pytest
+import struct
+import uuid
 from data.database_manager import DatabaseManager
 from data.client_manager import ClientManager
 
@@ -15,4 +17,25 @@ def test_add_client(client_manager: ClientManager):
 def test_duplicate_client(client_manager: ClientManager):
     client_manager.add_client("124", "Bob", b"public_key")
     with pytest.raises(Exception):
-        client_manager.add_client("125", "Bob", b"public_key")
\ No newline at end of file
+        client_manager.add_client("125", "Bob", b"public_key")
+
+def test_directory_since_returns_only_new_clients(tmp_path):
+    db_manager = DatabaseManager(str(tmp_path / "directory.db"))
+    db_manager.initialize_database()
+    client_manager = ClientManager(db_manager)
+    ids = [uuid.uuid4().bytes for _ in range(3)]
+    client_manager.add_client(ids[0], "Carol", b"key")
+    client_manager.add_client(ids[1], "Dave", b"key")
+
+    generation, records, full = client_manager.get_directory_since(0)
+    assert (generation, full) == (2, True)
+    assert records == struct.pack("16s 255s", ids[0], b"Carol") + struct.pack("16s 255s", ids[1], b"Dave")
+
+    client_manager.add_client(ids[2], "Erin", b"key")
+    assert client_manager.get_directory_since(2) == (3, struct.pack("16s 255s", ids[2], b"Erin"), False)
+    assert client_manager.get_directory_since(3) == (3, b"", False)
+    # a generation the server never issued (e.g. from before a database reset) gets the whole directory
+    generation, records, full = client_manager.get_directory_since(7)
+    assert (generation, len(records), full) == (3, 3 * ClientManager.DIRECTORY_RECORD_SIZE, True)
+    assert client_manager.get_directory() == records
+
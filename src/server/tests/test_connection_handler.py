@@ -1,9 +1,14 @@
 import pytest
 import socket
+import struct
+import threading
+import uuid
+from typing import NamedTuple
 from data.database_manager import DatabaseManager
 from data.client_manager import ClientManager
 from data.message_manager import MessageManager
 from communication.connection_handler import ConnectionHandler
+from communication.protocol import Protocol
 
 @pytest.fixture
 def setup_server():
@@ -18,7 +23,192 @@ def setup_server():
     yield server_socket
     server_socket.close()
 
+class HandlerConnection(NamedTuple):
+    client: socket.socket
+    thread: threading.Thread
+    client_manager: ClientManager
+    message_manager: MessageManager
+
+@pytest.fixture
+def handler_connection(tmp_path):
+    """A ConnectionHandler serving one end of a socket pair on its own thread, over a fresh database."""
+    db_manager = DatabaseManager(str(tmp_path / "handler.db"))
+    db_manager.initialize_database()
+    client_manager = ClientManager(db_manager)
+    message_manager = MessageManager(db_manager, client_manager)
+    client_side, server_side = socket.socketpair()
+    handler = ConnectionHandler(server_side, ("local", 0), client_manager, message_manager)
+    thread = threading.Thread(target=handler.handle)
+    thread.start()
+    yield HandlerConnection(client_side, thread, client_manager, message_manager)
+    client_side.close()
+    thread.join(timeout=5)
+
 def test_client_connection(setup_server):
     client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
     client_socket.connect(("127.0.0.1", 1357))
     client_socket.close()
+
+
+def _receive_response(sock: socket.socket) -> tuple[int, int, bytes]:
+    header = b""
+    while len(header) < 7:
+        header += sock.recv(7 - len(header))
+    version, code, size = struct.unpack(Protocol.RESPONSE_HEADER_FORMAT, header)
+    payload = b""
+    while len(payload) < size:
+        payload += sock.recv(size - len(payload))
+    return version, code, payload
+
+def test_keep_alive_serves_many_requests(handler_connection):
+    client_side, thread = handler_connection.client, handler_connection.thread
+
+    for _ in range(3):
+        client_side.sendall(Protocol.create_request(b"", 1, 999, b""))
+        version, code, payload = _receive_response(client_side)
+        assert code == 9000
+
+    client_side.close()
+    thread.join(timeout=5)
+    assert not thread.is_alive()
+
+def test_batch_send_returns_status_per_record(handler_connection):
+    client_side, client_manager, message_manager = handler_connection.client, handler_connection.client_manager, handler_connection.message_manager
+    sender, recipient, unknown = uuid.uuid4().bytes, uuid.uuid4().bytes, uuid.uuid4().bytes
+    client_manager.add_client(sender, f"sender-{sender.hex()}", b"key")
+    client_manager.add_client(recipient, f"recipient-{recipient.hex()}", b"key")
+
+    records = [(recipient, b"one"), (unknown, b"two"), (recipient, b"three")]
+    payload = b"".join(struct.pack(Protocol.MESSAGE_HEADER_FORMAT, to, sender, 3, len(content)) + content
+                       for to, content in records)
+
+    client_side.sendall(Protocol.create_request(sender, 1, 605, payload))
+    version, code, response = _receive_response(client_side)
+    assert code == 2105
+    statuses = [struct.unpack_from("<16s I B", response, offset) for offset in range(0, len(response), 21)]
+    assert [(to, status) for to, _, status in statuses] == [(recipient, 0), (unknown, 1), (recipient, 0)]
+
+    client_side.sendall(Protocol.create_request(sender, 1, 605, payload[:-1]))
+    version, code, response = _receive_response(client_side)
+    assert code == 9000
+
+    assert len(message_manager.get_messages_for_client(recipient)) == 2
+
+def test_multicast_returns_status_per_recipient(handler_connection):
+    client_side, client_manager = handler_connection.client, handler_connection.client_manager
+    sender, first, second, unknown = (uuid.uuid4().bytes for _ in range(4))
+    for client_id in (sender, first, second):
+        client_manager.add_client(client_id, f"user-{client_id.hex()}", b"key")
+
+    recipients = [first, unknown, second]
+    content = b"Request for symetric key"
+    payload = (struct.pack(Protocol.MULTICAST_HEADER_FORMAT, sender, 1, len(recipients), len(content))
+               + b"".join(recipients) + content)
+
+    client_side.sendall(Protocol.create_request(sender, 1, 606, payload))
+    version, code, response = _receive_response(client_side)
+    assert code == 2106
+    statuses = [struct.unpack_from("<16s I B", response, offset) for offset in range(0, len(response), 21)]
+    assert [(to, status) for to, _, status in statuses] == [(first, 0), (unknown, 1), (second, 0)]
+
+    client_side.sendall(Protocol.create_request(first, 1, 604, b""))
+    version, code, response = _receive_response(client_side)
+    assert code == 2104
+    from_client, _, message_type, size = struct.unpack_from("<16s I B I", response)
+    assert (from_client, message_type, response[25:25 + size]) == (sender, 1, content)
+
+def test_paged_fetch_deletes_only_acknowledged_messages(handler_connection):
+    client_side, client_manager, message_manager = handler_connection.client, handler_connection.client_manager, handler_connection.message_manager
+    sender, recipient = uuid.uuid4().bytes, uuid.uuid4().bytes
+    client_manager.add_client(sender, f"sender-{sender.hex()}", b"key")
+    client_manager.add_client(recipient, f"recipient-{recipient.hex()}", b"key")
+    message_manager.add_messages([(recipient, sender, 3, f"message {i}".encode()) for i in range(3)])
+
+    def fetch_page(ack_id: int, after_id: int) -> tuple[bool, list[tuple[int, bytes]]]:
+        client_side.sendall(Protocol.create_request(recipient, 1, 607, struct.pack("<IIII", ack_id, after_id, 2, 1 << 20)))
+        version, code, response = _receive_response(client_side)
+        assert code == 2107
+        records, offset = [], 1
+        while offset < len(response):
+            _, message_id, _, size = struct.unpack_from("<16s I B I", response, offset)
+            records.append((message_id, response[offset + 25:offset + 25 + size]))
+            offset += 25 + size
+        return response[0] == 1, records
+
+    has_more, first_page = fetch_page(0, 0)
+    assert has_more and [content for _, content in first_page] == [b"message 0", b"message 1"]
+    # the second page is requested before the first one is acknowledged
+    has_more, second_page = fetch_page(0, first_page[-1][0])
+    assert not has_more and [content for _, content in second_page] == [b"message 2"]
+    assert len(message_manager.get_messages_for_client(recipient)) == 3
+
+    has_more, last_page = fetch_page(second_page[-1][0], second_page[-1][0])
+    assert not has_more and last_page == []
+    assert message_manager.get_messages_for_client(recipient) == []
+
+def test_fetched_messages_carry_the_version_they_were_sent_with(handler_connection):
+    client_side, client_manager = handler_connection.client, handler_connection.client_manager
+    sender, recipient = uuid.uuid4().bytes, uuid.uuid4().bytes
+    client_manager.add_client(sender, f"sender-{sender.hex()}", b"key")
+    client_manager.add_client(recipient, f"recipient-{recipient.hex()}", b"key")
+
+    # the response version is the lower of the request's and the server's
+    for request_version, content in ((1, b"cbc"), (2, b"gcm")):
+        payload = struct.pack(Protocol.MESSAGE_HEADER_FORMAT, recipient, sender, 3, len(content)) + content
+        client_side.sendall(Protocol.create_request(sender, request_version, 603, payload))
+        version, code, _ = _receive_response(client_side)
+        assert (version, code) == (request_version, 2103)
+
+    # a version 2 fetch has [1 version] after the type of each record
+    client_side.sendall(Protocol.create_request(recipient, 3, 607, struct.pack("<IIII", 0, 0, 10, 1 << 20)))
+    version, code, response = _receive_response(client_side)
+    assert (version, code) == (ConnectionHandler.SERVER_VERSION, 2107)
+    records, offset = [], 1
+    while offset < len(response):
+        _, _, message_type, message_version, size = struct.unpack_from("<16s I B B I", response, offset)
+        records.append((message_version, response[offset + 26:offset + 26 + size]))
+        offset += 26 + size
+    assert records == [(1, b"cbc"), (2, b"gcm")]
+
+    # a version 1 fetch keeps the 25-byte record header
+    client_side.sendall(Protocol.create_request(recipient, 1, 604, b""))
+    version, code, response = _receive_response(client_side)
+    assert (version, code) == (1, 2104)
+    _, _, _, size = struct.unpack_from("<16s I B I", response)
+    assert response[25:25 + size] == b"cbc"
+
+def test_directory_sync_returns_clients_added_since_known_generation(handler_connection):
+    client_side, client_manager = handler_connection.client, handler_connection.client_manager
+    first, second = uuid.uuid4().bytes, uuid.uuid4().bytes
+    client_manager.add_client(first, "Frank", b"key")
+
+    client_side.sendall(Protocol.create_request(first, 1, 608, struct.pack("<I", 0)))
+    version, code, response = _receive_response(client_side)
+    assert code == 2108 and response == struct.pack("<IB16s255s", 1, 1, first, b"Frank")
+
+    client_manager.add_client(second, "Grace", b"key")
+    client_side.sendall(Protocol.create_request(first, 1, 608, struct.pack("<I", 1)))
+    version, code, response = _receive_response(client_side)
+    assert code == 2108 and response == struct.pack("<IB16s255s", 2, 0, second, b"Grace")
+
+
+def test_register_accepts_rsa_and_x25519_public_keys(handler_connection):
+    client_side = handler_connection.client
+
+    rsa_key, x25519_key = b"r" * 160, b"x" * 32
+    client_side.sendall(Protocol.create_request(bytes(16), 1, 600, struct.pack("<255s", b"Heidi") + rsa_key))
+    version, code, heidi = _receive_response(client_side)
+    assert code == 2100 and len(heidi) == 16
+    client_side.sendall(Protocol.create_request(bytes(16), 2, 600, struct.pack("<255s", b"Ivan") + x25519_key))
+    version, code, ivan = _receive_response(client_side)
+    assert code == 2100 and len(ivan) == 16
+    client_side.sendall(Protocol.create_request(bytes(16), 2, 600, struct.pack("<255s", b"Judy") + b"k" * 64))
+    version, code, _ = _receive_response(client_side)
+    assert code == 9000
+
+    client_side.sendall(Protocol.create_request(heidi, 2, 602, ivan))
+    version, code, response = _receive_response(client_side)
+    assert code == 2102 and response == x25519_key
+    client_side.sendall(Protocol.create_request(ivan, 2, 602, heidi))
+    version, code, response = _receive_response(client_side)
+    assert code == 2102 and response == rsa_key
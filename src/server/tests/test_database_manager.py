@@ -1,4 +1,5 @@
 import os
+import sqlite3
 import pytest
 import shutil
 from data.database_manager import DatabaseManager
@@ -20,3 +21,28 @@ def test_insert_and_fetch_client(db_manager):
     result = db_manager.fetch_query("SELECT * FROM clients WHERE ID = ?", ("123",))
     assert len(result) == 1
     assert result[0][1] == "Alice"
+
+def test_initialize_migrates_messages_without_content_id(tmp_path):
+    old_db = str(tmp_path / "old.db")
+    with sqlite3.connect(old_db) as conn:
+        conn.execute("""CREATE TABLE messages (ID INTEGER PRIMARY KEY AUTOINCREMENT, ToClient TEXT NOT NULL,
+                        FromClient TEXT NOT NULL, Type INTEGER NOT NULL, Content BLOB NOT NULL)""")
+        conn.execute("INSERT INTO messages (ToClient, FromClient, Type, Content) VALUES ('a', 'b', 3, x'01')")
+
+    db_manager = DatabaseManager(old_db)
+    db_manager.initialize_database()
+    columns = [row[1] for row in db_manager.fetch_query("PRAGMA table_info(messages)")]
+    assert "ContentID" in columns and "Version" in columns
+    assert db_manager.fetch_query("SELECT Content, ContentID, Version FROM messages") == [(b"\x01", None, 1)]
+
+def test_initialize_numbers_existing_clients_by_generation(tmp_path):
+    old_db = str(tmp_path / "old_clients.db")
+    with sqlite3.connect(old_db) as conn:
+        conn.execute("""CREATE TABLE clients (ID BOLD PRIMARY KEY, UserName TEXT NOT NULL UNIQUE,
+                        PublicKey BLOB NOT NULL, LastSeen TEXT)""")
+        conn.executemany("INSERT INTO clients (ID, UserName, PublicKey) VALUES (?, ?, x'00')", [("a", "Ann"), ("b", "Ben")])
+
+    db_manager = DatabaseManager(old_db)
+    db_manager.initialize_database()
+    assert db_manager.fetch_query("SELECT UserName, Generation FROM clients ORDER BY Generation") == [("Ann", 1), ("Ben", 2)]
+
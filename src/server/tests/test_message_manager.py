@@ -1,4 +1,5 @@
 import pytest
+import uuid
 from data.database_manager import DatabaseManager
 from data.client_manager import ClientManager
 from data.message_manager import MessageManager
@@ -27,4 +28,66 @@ def test_delete_message(message_manager: MessageManager):
     remaining_messages = message_manager.get_messages_for_client("123")
     print(f"Retrieved messages after deletion: {remaining_messages}")
 
-    assert len(remaining_messages) == 0 
\ No newline at end of file
+    assert len(remaining_messages) == 0
+
+def test_add_messages_stores_batch_with_per_record_status(message_manager: MessageManager):
+    sender, recipient = uuid.uuid4().bytes, uuid.uuid4().bytes
+    message_manager.client_manager.add_client(sender, f"sender-{sender.hex()}", b"key")
+    message_manager.client_manager.add_client(recipient, f"recipient-{recipient.hex()}", b"key")
+    unknown = uuid.uuid4().bytes
+
+    results = message_manager.add_messages([
+        (recipient, sender, 3, b"first"),
+        (unknown, sender, 3, b"lost"),
+        (recipient, sender, 3, b"second"),
+    ])
+
+    assert results[1] is None
+    assert results[0] is not None and results[2] is not None and results[0] < results[2]
+    messages = message_manager.get_messages_for_client(recipient)
+    assert [m[3] for m in messages] == [b"first", b"second"]
+
+def test_multicast_stores_content_once(message_manager: MessageManager):
+    sender = uuid.uuid4().bytes
+    recipients = [uuid.uuid4().bytes for _ in range(3)]
+    for client_id in [sender] + recipients:
+        message_manager.client_manager.add_client(client_id, f"user-{client_id.hex()}", b"key")
+    unknown = uuid.uuid4().bytes
+
+    results = message_manager.add_multicast_message(sender, recipients + [unknown], 1, b"shared blob")
+    assert results[3] is None and all(r is not None for r in results[:3])
+
+    db_manager = message_manager.db_manager
+    content_rows = db_manager.fetch_query("SELECT ID, RefCount FROM contents WHERE Content = ?", (b"shared blob",))
+    assert len(content_rows) == 1 and content_rows[0][1] == 3
+    content_id = content_rows[0][0]
+
+    for recipient in recipients:
+        messages = message_manager.get_messages_for_client(recipient)
+        assert [m[3] for m in messages] == [b"shared blob"]
+
+    # the shared content lives until the last mailbox entry referring to it is deleted
+    for i, message_id in enumerate(results[:3]):
+        message_manager.delete_message(message_id)
+        remaining = db_manager.fetch_query("SELECT RefCount FROM contents WHERE ID = ?", (content_id,))
+        assert remaining == ([(2 - i,)] if i < 2 else [])
+
+def test_message_pages_and_acknowledged_delete(message_manager: MessageManager):
+    sender, recipient = uuid.uuid4().bytes, uuid.uuid4().bytes
+    message_manager.client_manager.add_client(sender, f"sender-{sender.hex()}", b"key")
+    message_manager.client_manager.add_client(recipient, f"recipient-{recipient.hex()}", b"key")
+    ids = message_manager.add_messages([(recipient, sender, 3, bytes([i]) * 100) for i in range(5)])
+
+    # the byte limit cuts the page before the count limit does
+    page, has_more = message_manager.get_message_page(recipient, 0, 4, 2 * 125)
+    assert [m[0] for m in page] == ids[:2] and has_more
+
+    # a single message larger than the byte limit is still returned, so the fetch always progresses
+    page, has_more = message_manager.get_message_page(recipient, ids[1], 4, 10)
+    assert [m[0] for m in page] == [ids[2]] and has_more
+
+    page, has_more = message_manager.get_message_page(recipient, ids[2], 4, 10_000)
+    assert [m[0] for m in page] == ids[3:] and not has_more
+
+    assert message_manager.delete_messages_up_to(recipient, ids[2]) == 3
+    assert [m[0] for m in message_manager.get_messages_for_client(recipient)] == ids[3:]
@@ -0,0 +1,38 @@
+import os
+import re
+import struct
+from communication import schema
+
+WIRE_SCHEMA_PATH = os.path.abspath(os.path.join(os.path.dirname(__file__), "../../client/client/client/WireSchema.h"))
+
+def layout_names():
+    return [name[:-len("_FORMAT")] for name in dir(schema) if name.endswith("_FORMAT")]
+
+def test_formats_match_sizes_and_fields():
+    """Tests that every generated format packs to its declared size and fields, with no padding."""
+    assert layout_names()
+    for name in layout_names():
+        format_string = getattr(schema, f"{name}_FORMAT")
+        fields = getattr(schema, f"{name}_FIELDS")
+        assert format_string.startswith("<"), name
+        assert struct.calcsize(format_string) == getattr(schema, f"{name}_SIZE"), name
+
+        codes = format_string[1:].split()
+        assert len(codes) == len(fields), name
+        offset = 0
+        for code, (field_offset, field_size) in zip(codes, fields.values()):
+            assert field_offset == offset, name
+            assert struct.calcsize("<" + code) == field_size, name
+            offset += field_size
+
+def test_schema_matches_client_layouts():
+    """Tests that schema.py has the layouts (and sizes) that the C++ client checks at compile time."""
+    with open(WIRE_SCHEMA_PATH, encoding="utf-8-sig") as f:
+        header = f.read()
+    client_sizes = dict(re.findall(r"static_assert\(isContiguous<(\w+)>\(\) && \1::SIZE == (\d+)\);", header))
+    assert client_sizes
+
+    python_names = {re.sub(r"(?<=[a-z0-9])(?=[A-Z])", "_", name).upper(): int(size) for name, size in client_sizes.items()}
+    assert set(python_names) == set(layout_names())
+    for name, size in python_names.items():
+        assert getattr(schema, f"{name}_SIZE") == size, name
\ No newline at end of file